@@ -8,6 +8,7 @@
 #define LOOKUP_CACHE true
 #define STATIC_PREDICTION_BYTECODES true
 
+#define COUNT_EXECUTIONS false
 #define REPORT_GC false
 #define TEST_SLOW_PATH false
 #define TRACE_BECOME false
@@ -6,22 +6,60 @@
 
 #include "vm/interpreter.h"
 #include "vm/os.h"
+#include "vm/page_pool.h"
 
 namespace psoup {
 
+static VirtualMemory AllocateRegion(size_t size) {
+  if (Heap::IsPooledSize(size)) {
+    return PagePool::Allocate(size);
+  }
+  return VirtualMemory::Allocate(size, VirtualMemory::kReadWrite,
+                                 "primordialsoup-heap");
+}
+
+static void FreeRegion(VirtualMemory memory) {
+  if (Heap::IsPooledSize(memory.size())) {
+    PagePool::Free(memory);
+  } else {
+    memory.Free();
+  }
+}
+
+void Semispace::Allocate(size_t size) {
+  memory_ = AllocateRegion(size);
+  ASSERT(Utils::IsAligned(memory_.base(), kObjectAlignment));
+  ASSERT(memory_.size() == size);
+#if defined(DEBUG)
+  MarkUnallocated();
+#endif
+}
+
+void Semispace::Free() {
+#if defined(DEBUG)
+  ReadWrite();  // From-space is inaccessible between collections.
+#endif
+  FreeRegion(memory_);
+}
+
 class HeapPage {
  public:
   static HeapPage* Allocate(intptr_t size) {
-    VirtualMemory memory = VirtualMemory::Allocate(size,
-                                                   VirtualMemory::kReadWrite,
-                                                   "primordialsoup-heap");
+    VirtualMemory memory = AllocateRegion(size);
     HeapPage* page = reinterpret_cast<HeapPage*>(memory.base());
     page->memory_ = memory;
     page->object_end_ = page->object_start();
     return page;
   }
 
-  void Free() { memory_.Free(); }
+  void Free() { FreeRegion(memory_); }
+  void DontNeed() {
+    memory_.DontNeed(object_start(), memory_.limit() - object_start());
+  }
+  void Truncate(uword object_end) {
+    object_end_ = object_end;
+    memory_.DontNeed(object_end, memory_.limit() - object_end);
+  }
 
   uword TryAllocate(intptr_t size) {
     ASSERT(Utils::IsAligned(size, kObjectAlignment));
@@ -54,29 +92,83 @@ class HeapPage {
   uword object_end_;
 };
 
+// Lives in the unused from-space during mark-sweep. Deep object graphs can
+// need more room than the semispace has, so pushes beyond its limit spill
+// into a malloc'd overflow area.
 class MarkStack {
  public:
   void Init(uword limit) {
     top_ = &stack_[0];
     end_ = reinterpret_cast<HeapObject**>(limit);
+    overflow_ = NULL;
+    overflow_size_ = 0;
+    overflow_capacity_ = 0;
+  }
+  void Cleanup() {
+    free(overflow_);
+    overflow_ = NULL;
   }
 
-  bool IsEmpty() const { return top_ == &stack_[0]; }
+  bool IsEmpty() const {
+    return (top_ == &stack_[0]) && (overflow_size_ == 0);
+  }
   void Push(HeapObject* obj) {
     if (top_ == end_) {
-      FATAL("Mark stack overflow");
+      PushOverflow(obj);
     } else {
       *top_++ = obj;
     }
   }
-  HeapObject* Pop() { return *--top_; }
+  HeapObject* Pop() {
+    if (overflow_size_ != 0) {
+      return overflow_[--overflow_size_];
+    }
+    return *--top_;
+  }
 
  private:
+  void PushOverflow(HeapObject* obj) {
+    if (overflow_size_ == overflow_capacity_) {
+      overflow_capacity_ = overflow_capacity_ == 0 ? 64 * KB
+                                                   : overflow_capacity_ * 2;
+      overflow_ = reinterpret_cast<HeapObject**>(
+          realloc(overflow_, overflow_capacity_ * sizeof(HeapObject*)));
+      if (overflow_ == NULL) {
+        FATAL("Out of memory");
+      }
+    }
+    overflow_[overflow_size_++] = obj;
+  }
+
   HeapObject** top_;
   HeapObject** end_;
+  HeapObject** overflow_;
+  intptr_t overflow_size_;
+  intptr_t overflow_capacity_;
   HeapObject* stack_[];
 };
 
+size_t Heap::default_soft_limit_ = 0;
+size_t Heap::default_hard_limit_ = 0;
+
+void Heap::SetLimits(size_t soft_limit, size_t hard_limit) {
+  default_soft_limit_ = soft_limit;
+  default_hard_limit_ = hard_limit;
+}
+
+int64_t Heap::default_pause_goal_ = 0;
+intptr_t Heap::default_max_tenure_age_ = kDefaultMaxTenureAge;
+
+void Heap::SetScavengePolicy(int64_t pause_goal, intptr_t max_tenure_age) {
+  if (max_tenure_age <= 0) {
+    max_tenure_age = kDefaultMaxTenureAge;
+  } else if (max_tenure_age > kMaxTenureAge) {
+    max_tenure_age = kMaxTenureAge;
+  }
+  default_pause_goal_ = pause_goal;
+  default_max_tenure_age_ = max_tenure_age;
+}
+
 Heap::Heap() :
     top_(0),
     end_(0),
@@ -84,11 +176,33 @@ Heap::Heap() :
     to_(),
     from_(),
     next_semispace_capacity_(kInitialSemispaceCapacity),
+    tenure_age_(1),
+    aged_survivor_bytes_(0),
+    last_survivor_bytes_(0),
+    low_survival_count_(0),
+    pause_goal_(default_pause_goal_),
+    max_tenure_age_(default_max_tenure_age_),
+    allocated_bytes_(0),
     pages_(NULL),
     freelist_(),
     old_size_(0),
     old_capacity_(0),
     old_limit_(0),
+    large_pages_(NULL),
+    cached_large_pages_(NULL),
+    large_size_(0),
+    large_capacity_(0),
+    cached_large_capacity_(0),
+    soft_limit_(default_soft_limit_),
+    hard_limit_(default_hard_limit_),
+    over_soft_limit_(false),
+    over_hard_limit_(false),
+    memory_pressure_(false),
+    scavenge_count_(0),
+    scavenge_time_(0),
+    mark_sweep_count_(0),
+    mark_sweep_time_(0),
+    longest_pause_(0),
     remembered_set_(NULL),
     remembered_set_size_(0),
     remembered_set_capacity_(0),
@@ -100,11 +214,17 @@ Heap::Heap() :
     handles_(),
     handles_size_(0),
     ephemeron_list_(NULL),
-    weak_list_(NULL) {
+    weak_list_(NULL),
+    finalization_queue_(NULL),
+    finalization_queue_size_(0),
+    finalization_queue_capacity_(0),
+    forwarding_low_(0),
+    forwarding_high_(0) {
   to_.Allocate(kInitialSemispaceCapacity);
   from_.Allocate(kInitialSemispaceCapacity);
   top_ = to_.object_start();
   end_ = to_.limit();
+  survivor_end_ = top_;
 
   remembered_set_capacity_ = 1024;
   remembered_set_ = new HeapObject*[remembered_set_capacity_];
@@ -132,8 +252,21 @@ Heap::~Heap() {
     page->Free();
     page = next;
   }
+  page = large_pages_;
+  while (page != NULL) {
+    HeapPage* next = page->next();
+    page->Free();
+    page = next;
+  }
+  page = cached_large_pages_;
+  while (page != NULL) {
+    HeapPage* next = page->next();
+    page->Free();
+    page = next;
+  }
   delete[] remembered_set_;
   delete[] class_table_;
+  free(finalization_queue_);
 }
 
 Message* Heap::AllocateMessage() {
@@ -163,6 +296,7 @@ uword Heap::AllocateNew(intptr_t size) {
     Scavenge(kNewSpace);
     addr = TryAllocateNew(size);
     if (addr == 0) {
+      allocated_bytes_ += size;
       return AllocateOldSmall(size, kControlGrowth);
     }
   }
@@ -209,13 +343,14 @@ uword Heap::AllocateOldSmall(intptr_t size, GrowthPolicy growth) {
 
 uword Heap::AllocateOldLarge(intptr_t size, GrowthPolicy growth) {
   ASSERT(size >= kLargeAllocation);
-  HeapPage* page = AllocatePage(size + AllocationSize(sizeof(HeapPage)),
-                                growth);
+  HeapPage* page = AllocateLargePage(size, growth);
   uword addr = page->TryAllocate(size);
   if (addr == 0) {
     FATAL1("Failed to allocate %" Pd " bytes\n", size);
   }
   old_size_ += size;
+  large_size_ += size;
+  allocated_bytes_ += size;
 #if defined(DEBUG)
   memset(reinterpret_cast<void*>(addr), kUninitializedByte, size);
 #endif
@@ -251,21 +386,13 @@ uword Heap::AllocateSnapshotSmall(intptr_t size) {
 
 uword Heap::AllocateSnapshotLarge(intptr_t size) {
   ASSERT(size >= kLargeAllocation);
-  uword addr;
-  HeapPage* page = HeapPage::Allocate(size + AllocationSize(sizeof(HeapPage)));
-  old_capacity_ += page->size();
-  // Keep the current page since it likely still has free space.
-  if (pages_ == NULL) {
-    pages_ = page;
-  } else {
-    page->set_next(pages_->next());
-    pages_->set_next(page);
-  }
-  addr = page->TryAllocate(size);
+  HeapPage* page = AllocateLargePage(size, kForceGrowth);
+  uword addr = page->TryAllocate(size);
   if (addr == 0) {
     FATAL1("Failed to allocate %" Pd " bytes\n", size);
   }
   old_size_ += size;
+  large_size_ += size;
 #if defined(DEBUG)
   memset(reinterpret_cast<void*>(addr), kUninitializedByte, size);
 #endif
@@ -273,8 +400,14 @@ uword Heap::AllocateSnapshotLarge(intptr_t size) {
 }
 
 HeapPage* Heap::AllocatePage(intptr_t page_size, GrowthPolicy growth) {
-  if ((growth == kControlGrowth) && ((old_size_ + page_size) > old_limit_)) {
-    MarkSweep(kOldSpace);
+  if (growth == kControlGrowth) {
+    if (((old_size_ + page_size) > old_limit_) ||
+        ExceedsHardLimit(page_size)) {
+      MarkSweep(kOldSpace);
+    }
+    if (ExceedsHardLimit(page_size)) {
+      SignalOutOfMemory();
+    }
   }
   HeapPage* page = HeapPage::Allocate(page_size);
   old_capacity_ += page->size();
@@ -283,6 +416,65 @@ HeapPage* Heap::AllocatePage(intptr_t page_size, GrowthPolicy growth) {
   return page;
 }
 
+HeapPage* Heap::AllocateLargePage(intptr_t size, GrowthPolicy growth) {
+  intptr_t page_size = AllocationSize(sizeof(HeapPage)) + size +
+      CardTableSize(size);
+  if (growth == kControlGrowth) {
+    if (((old_size_ + page_size) > old_limit_) ||
+        ExceedsHardLimit(page_size)) {
+      MarkSweep(kOldSpace);
+    }
+    if (ExceedsHardLimit(page_size)) {
+      SignalOutOfMemory();
+    }
+  }
+  HeapPage* page = TakeCachedLargePage(page_size);
+  if (page == NULL) {
+    page = HeapPage::Allocate(page_size);
+  }
+  old_capacity_ += page->size();
+  large_capacity_ += page->size();
+  page->set_next(large_pages_);
+  large_pages_ = page;
+  memset(reinterpret_cast<void*>(page->object_start() + size), 0,
+         CardTableSize(size));
+  return page;
+}
+
+HeapPage* Heap::TakeCachedLargePage(intptr_t page_size) {
+  // First fit, but don't waste more than half of a reused page.
+  HeapPage* prev = NULL;
+  HeapPage* page = cached_large_pages_;
+  while (page != NULL) {
+    intptr_t available = page->size();
+    if ((available >= page_size) && (available / 2 <= page_size)) {
+      if (prev == NULL) {
+        cached_large_pages_ = page->next();
+      } else {
+        prev->set_next(page->next());
+      }
+      cached_large_capacity_ -= page->size();
+      page->set_next(NULL);
+      page->set_object_end(page->object_start());
+      return page;
+    }
+    prev = page;
+    page = page->next();
+  }
+  return NULL;
+}
+
+void Heap::ReleaseLargePage(HeapPage* page) {
+  if (cached_large_capacity_ + page->size() > kLargePageCacheCapacity) {
+    page->Free();
+    return;
+  }
+  page->DontNeed();
+  cached_large_capacity_ += page->size();
+  page->set_next(cached_large_pages_);
+  cached_large_pages_ = page;
+}
+
 void Heap::GrowRememberedSet() {
   // TODO(rmacnak): Investigate a limit to trigger GC instead of letting this
   // grow in an unbounded way.
@@ -321,11 +513,17 @@ void Heap::ShrinkRememberedSet() {
 }
 
 void Heap::Scavenge(Reason reason) {
-#if REPORT_GC
   int64_t start = OS::CurrentMonotonicNanos();
+#if REPORT_GC
   size_t new_before = top_ - to_.object_start();
+  size_t allocated = top_ - survivor_end_;
 #endif
   size_t old_before = old_size_;
+  allocated_bytes_ += top_ - survivor_end_;
+  for (intptr_t age = 0; age <= kMaxTenureAge; age++) {
+    survivor_bytes_[age] = 0;
+  }
+  aged_survivor_bytes_ = 0;
 
   FlipSpaces();
 
@@ -338,11 +536,13 @@ void Heap::Scavenge(Reason reason) {
   // Strong references.
   ScavengeRoots();
   uword scan = to_.object_start();
-  while (scan < top_ || end_ < to_.limit()) {
-    scan = ScavengeToSpace(scan);
-    ProcessTenureStack();
-    ScavengeEphemeronList();
-  }
+  do {
+    while (scan < top_ || end_ < to_.limit()) {
+      scan = ScavengeToSpace(scan);
+      ProcessTenureStack();
+      ScavengeEphemeronList();
+    }
+  } while (FinalizeEphemeronListScavenge());
 
   // Weak references.
   MournEphemeronList();
@@ -363,21 +563,24 @@ void Heap::Scavenge(Reason reason) {
   size_t tenured = old_after - old_before;
   size_t survived = new_after + tenured;
 
-  if (survived > (to_.size() / 3)) {
-    next_semispace_capacity_ = to_.size() * 2;
-    if (next_semispace_capacity_ > kMaxSemispaceCapacity) {
-      next_semispace_capacity_ = kMaxSemispaceCapacity;
-    }
+  int64_t stop = OS::CurrentMonotonicNanos();
+  int64_t time = stop - start;
+  scavenge_count_++;
+  scavenge_time_ += time;
+  if (time > longest_pause_) {
+    longest_pause_ = time;
   }
+  AdjustScavengePolicy(survived, time);
+  last_survivor_bytes_ = new_after;
 
 #if REPORT_GC
   size_t freed = (new_before + old_before) - (new_after + old_after);
-  int64_t stop = OS::CurrentMonotonicNanos();
-  int64_t time = stop - start;
-  OS::PrintErr("Scavenge (%s, %" Pd "kB new, "
-               "%" Pd "kB tenured, %" Pd "kB freed, %" Pd64 " us)\n",
-               ReasonToCString(reason), new_after / KB, tenured / KB,
-               freed / KB, time / kNanosecondsPerMicrosecond);
+  OS::PrintErr("Scavenge (%s, %" Pd "kB allocated, %" Pd "kB new, "
+               "%" Pd "kB tenured, %" Pd "kB freed, %" Pd64 " us, "
+               "tenure age %" Pd ")\n",
+               ReasonToCString(reason), allocated / KB, new_after / KB,
+               tenured / KB, freed / KB, time / kNanosecondsPerMicrosecond,
+               tenure_age_);
 #endif
 
   ASSERT(reason == kNewSpace ||
@@ -388,6 +591,8 @@ void Heap::Scavenge(Reason reason) {
   // perform an extra one for tenure.
   if ((reason == kNewSpace) && (old_size_ > old_limit_)) {
     MarkSweep(kTenure);
+  } else {
+    CheckLimits();
   }
 }
 
@@ -396,17 +601,27 @@ void Heap::FlipSpaces() {
   to_ = from_;
   from_ = temp;
 
+  // A lowered hard limit also bounds a new space that has already grown.
+  if (next_semispace_capacity_ > MaxSemispaceCapacity()) {
+    next_semispace_capacity_ = MaxSemispaceCapacity();
+  }
   ASSERT(next_semispace_capacity_ <= kMaxSemispaceCapacity);
-  if (to_.size() < next_semispace_capacity_) {
-    if (TRACE_GROWTH && (from_.size() < next_semispace_capacity_)) {
-      OS::PrintErr("Growing new space to %" Pd "MB\n",
-                   next_semispace_capacity_ / MB);
+  // Every object in from-space takes at most its size in to-space, either
+  // copied or as a tenure stack entry, so to-space only shrinks to what is
+  // in use.
+  size_t in_use = top_ - from_.base();
+  if ((to_.size() < next_semispace_capacity_) ||
+      ((to_.size() > next_semispace_capacity_) &&
+       (in_use <= next_semispace_capacity_))) {
+    if (TRACE_GROWTH && (from_.size() != next_semispace_capacity_)) {
+      OS::PrintErr("Resizing new space to %" Pd "kB\n",
+                   next_semispace_capacity_ / KB);
     }
     to_.Free();
     to_.Allocate(next_semispace_capacity_);
   }
 
-  ASSERT(to_.size() >= from_.size());
+  ASSERT(to_.size() >= in_use);
 
   top_ = to_.object_start();
   end_ = to_.limit();
@@ -429,15 +644,6 @@ static void ForwardClass(Heap* heap, HeapObject* object) {
   }
 }
 
-static void ForwardPointer(Object** ptr) {
-  Object* old_target = *ptr;
-  if (old_target->IsForwardingCorpse()) {
-    Object* new_target = static_cast<ForwardingCorpse*>(old_target)->target();
-    ASSERT(!new_target->IsForwardingCorpse());
-    *ptr = new_target;
-  }
-}
-
 void Heap::ScavengeRoots() {
   // Process the remembered set first so we can visit and reset in one pass.
   intptr_t saved_remembered_set_size = remembered_set_size_;
@@ -446,6 +652,10 @@ void Heap::ScavengeRoots() {
   for (intptr_t i = 0; i < saved_remembered_set_size; i++) {
     HeapObject* obj = remembered_set_[i];
     ASSERT(obj->IsOldObject());
+    if (IsCarded(obj)) {
+      ScavengeCards(obj);
+      continue;
+    }
     ASSERT(obj->is_remembered());
     obj->set_is_remembered(false);
     ScavengeOldObject(obj);
@@ -455,6 +665,10 @@ void Heap::ScavengeRoots() {
     ScavengePointer(handles_[i]);
   }
 
+  for (intptr_t i = 0; i < finalization_queue_size_; i++) {
+    ScavengePointer(reinterpret_cast<Object**>(&finalization_queue_[i]));
+  }
+
   Object** from;
   Object** to;
   interpreter_->RootPointers(&from, &to);
@@ -551,22 +765,8 @@ void Heap::ScavengePointer(Object** ptr) {
   if (IsForwarded(old_target)) {
     new_target = ForwardingTarget(old_target);
   } else {
-    // Target is now known to be reachable. Move it to to-space.
-    intptr_t size = old_target->HeapSize();
-
-    uword new_target_addr;
-    if (old_target->Addr() < survivor_end_) {
-      new_target_addr = AllocateTenure(size);
-    } else {
-      new_target_addr = TryAllocateNew(size);
-    }
-
-    ASSERT(new_target_addr != 0);
-    memcpy(reinterpret_cast<void*>(new_target_addr),
-           reinterpret_cast<void*>(old_target->Addr()),
-           size);
-    new_target = HeapObject::FromAddr(new_target_addr);
-    SetForwarded(old_target, new_target);
+    // Target is now known to be reachable.
+    new_target = Evacuate(old_target);
   }
 
   DEBUG_ASSERT(new_target->IsOldObject() || InToSpace(new_target));
@@ -594,6 +794,35 @@ void Heap::ScavengeOldObject(HeapObject* obj) {
   }
 }
 
+void Heap::ScavengeCards(HeapObject* obj) {
+  ASSERT(!obj->is_remembered());
+  ScavengeClass(obj->cid());
+  uint8_t* cards = CardTable(obj);
+  ASSERT(cards[0] != 0);
+  cards[0] = 0;
+  Object** from;
+  Object** to;
+  obj->Pointers(&from, &to);
+  intptr_t num_cards = CardTableSize(obj->HeapSize()) - 1;
+  for (intptr_t i = 0; i < num_cards; i++) {
+    if (cards[1 + i] == 0) {
+      continue;
+    }
+    cards[1 + i] = 0;
+    uword card_start = obj->Addr() + (i << kCardSizeLog2);
+    Object** card_from = reinterpret_cast<Object**>(card_start);
+    Object** card_to = reinterpret_cast<Object**>(card_start + kCardSize) - 1;
+    if (card_from < from) card_from = from;
+    if (card_to > to) card_to = to;
+    for (Object** ptr = card_from; ptr <= card_to; ptr++) {
+      ScavengePointer(ptr);
+      if ((*ptr)->IsNewObject()) {
+        MarkCard(obj, ptr);
+      }
+    }
+  }
+}
+
 void Heap::ScavengeClass(intptr_t cid) {
   ASSERT(cid < class_table_size_);
   // This is very similar to ScavengePointer.
@@ -610,28 +839,119 @@ void Heap::ScavengeClass(intptr_t cid) {
     return;
   }
 
-  // Target is now known to be reachable. Move it to to-space.
+  // Target is now known to be reachable.
+  Evacuate(old_target);
+}
+
+// Moves an object to to-space, or to old space once it has survived
+// tenure_age_ scavenges. Tenures early if to-space is full, which can only
+// happen while it is shrinking.
+HeapObject* Heap::Evacuate(HeapObject* old_target) {
   intptr_t size = old_target->HeapSize();
+  intptr_t age = old_target->age();
 
-  uword new_target_addr;
-  if (old_target->Addr() < survivor_end_) {
-    new_target_addr = AllocateTenure(size);
-  } else {
+  if (age != 0) {
+    aged_survivor_bytes_ += size;
+  }
+
+  uword new_target_addr = 0;
+  if (age < tenure_age_) {
     new_target_addr = TryAllocateNew(size);
   }
+  if (new_target_addr == 0) {
+    new_target_addr = AllocateTenure(size);
+  }
 
-  ASSERT(new_target_addr != 0);
   memcpy(reinterpret_cast<void*>(new_target_addr),
          reinterpret_cast<void*>(old_target->Addr()),
          size);
   HeapObject* new_target = HeapObject::FromAddr(new_target_addr);
+  if (new_target->IsNewObject()) {
+    if (age < kMaxTenureAge) {
+      age++;
+      new_target->set_age(age);
+    }
+    survivor_bytes_[age] += size;
+  }
   SetForwarded(old_target, new_target);
+  return new_target;
+}
+
+void Heap::AdjustScavengePolicy(size_t survived, int64_t pause) {
+  // Keeping objects in new space longer only pays if they die there. Raise
+  // the tenure age while few objects that had already survived a scavenge
+  // survive this one, and lower it when most do.
+  if (last_survivor_bytes_ != 0) {
+    if (aged_survivor_bytes_ * 2 > last_survivor_bytes_) {
+      if (tenure_age_ > 1) {
+        tenure_age_--;
+      }
+    } else if (aged_survivor_bytes_ * 4 < last_survivor_bytes_) {
+      if (tenure_age_ < max_tenure_age_) {
+        tenure_age_++;
+      }
+    }
+  }
+  // Tenure sooner if survivors younger than the tenure age would take more
+  // than half of to-space, after Ungar and Jackson's feedback mediation.
+  size_t desired = to_.size() / 2;
+  size_t total = 0;
+  for (intptr_t age = 1; age < tenure_age_; age++) {
+    total += survivor_bytes_[age];
+    if (total > desired) {
+      tenure_age_ = age;
+      break;
+    }
+  }
+
+  size_t capacity = to_.size();
+  if ((pause_goal_ != 0) && (pause > pause_goal_)) {
+    // Copying survivors dominates the pause: copy each fewer times and let
+    // fewer objects be caught alive.
+    tenure_age_ = 1;
+    if (capacity > kInitialSemispaceCapacity) {
+      next_semispace_capacity_ = capacity / 2;
+    }
+    low_survival_count_ = 0;
+  } else if (survived > (capacity / 3)) {
+    if ((pause_goal_ == 0) || (pause < pause_goal_ / 2)) {
+      next_semispace_capacity_ = capacity * 2;
+      if (next_semispace_capacity_ > MaxSemispaceCapacity()) {
+        next_semispace_capacity_ = MaxSemispaceCapacity();
+      }
+    }
+    low_survival_count_ = 0;
+  } else if (survived < (capacity / 64)) {
+    // Give back a new space the program has stopped needing.
+    if (++low_survival_count_ >= 16) {
+      if (capacity > kInitialSemispaceCapacity) {
+        next_semispace_capacity_ = capacity / 2;
+      }
+      low_survival_count_ = 0;
+    }
+  } else {
+    low_survival_count_ = 0;
+  }
+}
+
+size_t Heap::MaxSemispaceCapacity() const {
+  // Both semispaces together stay within a quarter of the hard limit, unless
+  // that is less than the initial new space.
+  size_t capacity = kMaxSemispaceCapacity;
+  if (hard_limit_ != 0) {
+    while ((capacity > kInitialSemispaceCapacity) &&
+           (2 * capacity > hard_limit_ / 4)) {
+      capacity /= 2;
+    }
+  }
+  return capacity;
 }
 
 void Heap::MarkSweep(Reason reason) {
-#if REPORT_GC
   int64_t start = OS::CurrentMonotonicNanos();
+#if REPORT_GC
   size_t size_before = old_size_;
+  size_t large_capacity_before = large_capacity_;
 #endif
 
 #if defined(DEBUG)
@@ -644,15 +964,19 @@ void Heap::MarkSweep(Reason reason) {
   // Remembered set will be re-built during marking.
   remembered_set_size_ = 0;
   old_size_ = 0;
+  large_size_ = 0;
 
   interpreter_->GCPrologue();
 
   // Strong references.
   MarkRoots();
-  while (!mark_stack->IsEmpty()) {
-    ProcessMarkStack();
-    MarkEphemeronList();
-  }
+  do {
+    while (!mark_stack->IsEmpty()) {
+      ProcessMarkStack();
+      MarkEphemeronList();
+    }
+  } while (FinalizeEphemeronListMarkSweep());
+  mark_stack->Cleanup();
 
 #if defined(DEBUG)
   from_.NoAccess();
@@ -672,15 +996,24 @@ void Heap::MarkSweep(Reason reason) {
   ShrinkRememberedSet();
 
   SetOldAllocationLimit();
+  CheckLimits();
 
-#if REPORT_GC
-  size_t size_after = old_size_;
   int64_t stop = OS::CurrentMonotonicNanos();
   int64_t time = stop - start;
+  mark_sweep_count_++;
+  mark_sweep_time_ += time;
+  if (time > longest_pause_) {
+    longest_pause_ = time;
+  }
+
+#if REPORT_GC
+  size_t size_after = old_size_;
   OS::PrintErr("Mark-sweep "
-               "(%s, %" Pd "kB old, %" Pd "kB freed, %" Pd64 " us)\n",
+               "(%s, %" Pd "kB old, %" Pd "kB freed, "
+               "%" Pd "kB large, %" Pd "kB large released, %" Pd64 " us)\n",
                ReasonToCString(reason), size_after / KB,
-               (size_before - size_after) / KB,
+               (size_before - size_after) / KB, large_size_ / KB,
+               (large_capacity_before - large_capacity_) / KB,
                time / kNanosecondsPerMicrosecond);
 #endif
 }
@@ -690,6 +1023,10 @@ void Heap::MarkRoots() {
     MarkObject(*handles_[i]);
   }
 
+  for (intptr_t i = 0; i < finalization_queue_size_; i++) {
+    MarkObject(finalization_queue_[i]);
+  }
+
   Object** from;
   Object** to;
   interpreter_->RootPointers(&from, &to);
@@ -710,6 +1047,16 @@ void Heap::MarkObject(Object* obj) {
 
   heap_obj->set_is_marked(true);
   heap_obj->set_is_remembered(false);
+  if (heap_obj->IsBytes()) {
+    // Nothing to trace, so skip the mark stack. Large I/O buffers are
+    // typically bytes.
+    Object* cls = ClassAt(heap_obj->cid());
+    if (cls->IsNewObject() && heap_obj->IsOldObject()) {
+      AddToRememberedSet(heap_obj);
+    }
+    MarkObject(cls);
+    return;
+  }
   MarkStack* mark_stack = reinterpret_cast<MarkStack*>(from_.base());
   mark_stack->Push(heap_obj);
 }
@@ -736,6 +1083,17 @@ void Heap::ProcessMarkStack() {
       Object** from;
       Object** to;
       obj->Pointers(&from, &to);
+      if (obj->IsOldObject() && IsCarded(obj)) {
+        ClearCards(obj);
+        for (Object** ptr = from; ptr <= to; ptr++) {
+          Object* target = *ptr;
+          if (target->IsNewObject()) {
+            MarkCard(obj, ptr);
+          }
+          MarkObject(target);
+        }
+        continue;
+      }
       bool has_new_target = ClassAt(cid)->IsNewObject();
       for (Object** ptr = from; ptr <= to; ptr++) {
         Object* target = *ptr;
@@ -800,6 +1158,37 @@ void Heap::Sweep() {
       page = next;
     }
   }
+
+  SweepLargePages();
+}
+
+void Heap::SweepLargePages() {
+  // Each page holds one object, so only its header needs to be read.
+  HeapPage* prev = NULL;
+  HeapPage* page = large_pages_;
+  while (page != NULL) {
+    HeapObject* obj = HeapObject::FromAddr(page->object_start());
+    ASSERT(page->object_start() + obj->HeapSize() == page->object_end());
+    if (obj->is_marked()) {
+      obj->set_is_marked(false);
+      intptr_t size = obj->HeapSize();
+      old_size_ += size;
+      large_size_ += size;
+      prev = page;
+      page = page->next();
+    } else {
+      HeapPage* next = page->next();
+      if (prev == NULL) {
+        large_pages_ = next;
+      } else {
+        prev->set_next(next);
+      }
+      old_capacity_ -= page->size();
+      large_capacity_ -= page->size();
+      ReleaseLargePage(page);
+      page = next;
+    }
+  }
 }
 
 bool Heap::SweepPage(HeapPage* page) {
@@ -841,9 +1230,39 @@ void Heap::SetOldAllocationLimit() {
   if (TRACE_GROWTH) {
     OS::PrintErr("Old %" Pd "kB size, %" Pd "kB capacity, %" Pd "kB limit\n",
                  old_size_ / KB, old_capacity_ / KB, old_limit_ / KB);
+    OS::PrintErr("Large %" Pd "kB size, %" Pd "kB capacity, %" Pd "kB cached\n",
+                 large_size_ / KB, large_capacity_ / KB,
+                 cached_large_capacity_ / KB);
   }
 }
 
+void Heap::CheckLimits() {
+  size_t size = Size();
+  if (soft_limit_ != 0) {
+    bool over = size > soft_limit_;
+    if (over && !over_soft_limit_) {
+      memory_pressure_ = true;
+    }
+    over_soft_limit_ = over;
+  }
+  if (hard_limit_ != 0) {
+    if (size <= hard_limit_) {
+      over_hard_limit_ = false;
+    } else if (ExceedsHardLimit(0)) {
+      SignalOutOfMemory();
+    }
+  }
+}
+
+void Heap::SignalOutOfMemory() {
+  if (TRACE_GROWTH) {
+    OS::PrintErr("Heap of %" Pd "kB reached its %" Pd "kB hard limit\n",
+                 Size() / KB, hard_limit_ / KB);
+  }
+  over_hard_limit_ = true;
+  interpreter_->OutOfMemory();
+}
+
 void Heap::AddToEphemeronList(Ephemeron* survivor) {
   DEBUG_ASSERT(survivor->IsOldObject() || InToSpace(survivor));
   survivor->set_next(ephemeron_list_);
@@ -932,11 +1351,11 @@ void Heap::MournEphemeronList() {
   while (survivor != NULL) {
     ASSERT(survivor->IsEphemeron());
 
+    // Ephemerons with a finalizer were already queued by
+    // FinalizeEphemeronList*.
+    ASSERT(survivor->finalizer() == nil);
     survivor->set_key(nil, kNoBarrier);
     survivor->set_value(nil, kNoBarrier);
-    // TODO(rmacnak): Put the finalizer on a queue for the event loop
-    // to process.
-    survivor->set_finalizer(nil, kNoBarrier);
 
     Ephemeron* next = survivor->next();
     survivor->set_next(NULL);
@@ -944,6 +1363,109 @@ void Heap::MournEphemeronList() {
   }
 }
 
+// Ephemerons left on the list once tracing is done have keys that are only
+// reachable through ephemerons. Those with a finalizer fire: the key is
+// cleared, the value and finalizer are kept alive for the program, and the
+// ephemeron is queued. Answers whether any fired, since tracing the value and
+// finalizer may discover more objects and ephemerons.
+bool Heap::FinalizeEphemeronListScavenge() {
+  Object* nil = interpreter_->nil_obj();
+  Ephemeron* survivor = ephemeron_list_;
+  ephemeron_list_ = NULL;
+  bool fired = false;
+
+  while (survivor != NULL) {
+    ASSERT(survivor->IsEphemeron());
+    Ephemeron* next = survivor->next();
+    survivor->set_next(NULL);
+
+    if (survivor->finalizer() == nil) {
+      survivor->set_next(ephemeron_list_);
+      ephemeron_list_ = survivor;
+    } else {
+      survivor->set_key(nil, kNoBarrier);
+      ScavengePointer(survivor->value_ptr());
+      ScavengePointer(survivor->finalizer_ptr());
+
+      if (survivor->IsOldObject() &&
+          (survivor->value()->IsNewObject() ||
+           survivor->finalizer()->IsNewObject()) &&
+          !survivor->is_remembered()) {
+        AddToRememberedSet(survivor);
+      }
+      AddToFinalizationQueue(survivor);
+      fired = true;
+    }
+
+    survivor = next;
+  }
+  return fired;
+}
+
+bool Heap::FinalizeEphemeronListMarkSweep() {
+  Object* nil = interpreter_->nil_obj();
+  Ephemeron* survivor = ephemeron_list_;
+  ephemeron_list_ = NULL;
+  bool fired = false;
+
+  while (survivor != NULL) {
+    ASSERT(survivor->IsEphemeron());
+    Ephemeron* next = survivor->next();
+    survivor->set_next(NULL);
+
+    if (survivor->finalizer() == nil) {
+      survivor->set_next(ephemeron_list_);
+      ephemeron_list_ = survivor;
+    } else {
+      survivor->set_key(nil, kNoBarrier);
+      MarkObject(survivor->value());
+      MarkObject(survivor->finalizer());
+
+      if (survivor->IsOldObject() &&
+          (survivor->value()->IsNewObject() ||
+           survivor->finalizer()->IsNewObject()) &&
+          !survivor->is_remembered()) {
+        AddToRememberedSet(survivor);
+      }
+      AddToFinalizationQueue(survivor);
+      fired = true;
+    }
+
+    survivor = next;
+  }
+  return fired;
+}
+
+void Heap::AddToFinalizationQueue(Ephemeron* ephemeron) {
+  if (finalization_queue_size_ == finalization_queue_capacity_) {
+    finalization_queue_capacity_ = finalization_queue_capacity_ == 0
+        ? 64 : 2 * finalization_queue_capacity_;
+    finalization_queue_ = reinterpret_cast<Ephemeron**>(
+        realloc(finalization_queue_,
+                finalization_queue_capacity_ * sizeof(Ephemeron*)));
+    if (finalization_queue_ == NULL) {
+      FATAL("Out of memory");
+    }
+  }
+  finalization_queue_[finalization_queue_size_++] = ephemeron;
+}
+
+Object* Heap::TakeFinalizationQueue() {
+  intptr_t length = finalization_queue_size_;
+  if (length == 0) {
+    return interpreter_->nil_obj();
+  }
+  Array* result = AllocateArray(length);  // SAFEPOINT
+  // The allocation may have fired more ephemerons; they stay queued.
+  for (intptr_t i = 0; i < length; i++) {
+    result->set_element(i, finalization_queue_[i]);
+  }
+  finalization_queue_size_ -= length;
+  memmove(&finalization_queue_[0], &finalization_queue_[length],
+          finalization_queue_size_ * sizeof(Ephemeron*));
+  return result;
+}
+
 void Heap::AddToWeakList(WeakArray* survivor) {
   DEBUG_ASSERT(survivor->IsOldObject() || InToSpace(survivor));
   survivor->set_next(weak_list_);
@@ -1093,6 +1615,9 @@ bool Heap::BecomeForward(Array* old, Array* neu) {
 
   interpreter_->GCPrologue();  // Before creating forwarders!
 
+  forwarding_low_ = kUwordMax;
+  forwarding_high_ = 0;
+  bool forwarding_old_objects = false;
   for (intptr_t i = 0; i < length; i++) {
     HeapObject* forwarder = static_cast<HeapObject*>(old->element(i));
     HeapObject* forwardee = static_cast<HeapObject*>(neu->element(i));
@@ -1113,22 +1638,224 @@ bool Heap::BecomeForward(Array* old, Array* neu) {
     ASSERT(forwarder->HeapSize() == heap_size);
 
     corpse->set_target(forwardee);
+
+    uword tagged = reinterpret_cast<uword>(corpse);
+    if (tagged < forwarding_low_) forwarding_low_ = tagged;
+    if (tagged > forwarding_high_) forwarding_high_ = tagged;
+    if (corpse->IsOldObject()) forwarding_old_objects = true;
+  }
+
+  bool forwarding_classes = false;
+  for (intptr_t i = kFirstLegalCid; i < class_table_size_; i++) {
+    if (class_table_[i]->IsForwardingCorpse()) {
+      forwarding_classes = true;
+      break;
+    }
   }
 
   ForwardRoots();
-  ForwardHeap();  // Using old class table.
+  if (forwarding_old_objects || forwarding_classes) {
+    ForwardHeap();  // Using old class table.
+  } else {
+    // Old objects can only refer to new forwarders through the remembered
+    // set, and no instance needs its cid updated.
+    ForwardNewSpaceAndRememberedSet();
+  }
   ForwardClassTable();
 
+  forwarding_low_ = 0;
+  forwarding_high_ = 0;
+
   interpreter_->GCEpilogue();
 
   return true;
 }
 
+void Heap::Shrink(HeapObject* object, intptr_t new_heap_size) {
+  intptr_t old_heap_size = object->HeapSize();
+  ASSERT(Utils::IsAligned(new_heap_size, kObjectAlignment));
+  ASSERT(new_heap_size <= old_heap_size);
+  intptr_t freed = old_heap_size - new_heap_size;
+  if (freed == 0) {
+    return;
+  }
+  uword end = object->Addr() + new_heap_size;
+
+  if (object->IsOldObject()) {
+    old_size_ -= freed;
+    // A large page holds exactly one object, so it shrinks with the object.
+    for (HeapPage* page = large_pages_; page != NULL; page = page->next()) {
+      if (page->object_start() == object->Addr()) {
+        large_size_ -= freed;
+        page->Truncate(end);
+        return;
+      }
+    }
+  }
+
+  // Otherwise the tail becomes a free-list element: heap walks skip it, the
+  // sweeper reclaims it, and the scavenger never sees it since nothing refers
+  // to it.
+#if defined(DEBUG)
+  memset(reinterpret_cast<void*>(end), kUnallocatedByte, freed);
+#endif
+  HeapObject* filler = HeapObject::Initialize(end, kFreeListElementCid, freed);
+  if (filler->heap_size() == 0) {
+    static_cast<FreeListElement*>(filler)->set_overflow_size(freed);
+  }
+  ASSERT(filler->HeapSize() == freed);
+}
+
+// Where a page of the source heap was copied to.
+struct Relocation {
+  uword start;
+  uword end;
+  intptr_t delta;
+};
+
+static Object* Relocate(Object* obj,
+                        const Relocation* relocations,
+                        intptr_t count) {
+  if (obj->IsImmediateObject()) {
+    return obj;
+  }
+  uword addr = reinterpret_cast<uword>(obj);
+  intptr_t low = 0;
+  intptr_t high = count - 1;
+  while (low <= high) {
+    intptr_t mid = low + (high - low) / 2;
+    if (addr < relocations[mid].start) {
+      high = mid - 1;
+    } else if (addr >= relocations[mid].end) {
+      low = mid + 1;
+    } else {
+      return reinterpret_cast<Object*>(addr + relocations[mid].delta);
+    }
+  }
+  // Not in the source heap, e.g. a debug fill value in the class table.
+  return obj;
+}
+
+void Heap::CloneFrom(Heap* source) {
+  // A deserialized heap has everything in old space.
+  ASSERT(source->top_ == source->to_.object_start());
+  ASSERT(source->remembered_set_size_ == 0);
+  ASSERT(source->handles_size_ == 0);
+  ASSERT(source->finalization_queue_size_ == 0);
+  ASSERT((pages_ == NULL) && (large_pages_ == NULL));
+
+  intptr_t count = 0;
+  for (HeapPage* page = source->pages_; page != NULL; page = page->next()) {
+    count++;
+  }
+  for (HeapPage* page = source->large_pages_; page != NULL;
+       page = page->next()) {
+    count++;
+  }
+  Relocation* relocations =
+      reinterpret_cast<Relocation*>(malloc(count * sizeof(Relocation)));
+  if (relocations == NULL) {
+    FATAL("Out of memory");
+  }
+
+  intptr_t index = 0;
+  for (HeapPage* page = source->pages_; page != NULL; page = page->next()) {
+    HeapPage* copy = AllocatePage(page->size(), kForceGrowth);
+    memcpy(reinterpret_cast<void*>(copy->object_start()),
+           reinterpret_cast<void*>(page->object_start()), page->Size());
+    copy->set_object_end(copy->object_start() + page->Size());
+    relocations[index].start = page->object_start();
+    relocations[index].end = page->object_end();
+    relocations[index].delta = copy->object_start() - page->object_start();
+    index++;
+  }
+  for (HeapPage* page = source->large_pages_; page != NULL;
+       page = page->next()) {
+    HeapPage* copy = AllocateLargePage(page->Size(), kForceGrowth);
+    memcpy(reinterpret_cast<void*>(copy->object_start()),
+           reinterpret_cast<void*>(page->object_start()), page->Size());
+    copy->set_object_end(copy->object_start() + page->Size());
+    relocations[index].start = page->object_start();
+    relocations[index].end = page->object_end();
+    relocations[index].delta = copy->object_start() - page->object_start();
+    index++;
+  }
+  ASSERT(index == count);
+  old_size_ = source->old_size_;
+  large_size_ = source->large_size_;
+
+  // Sort by address for the binary search. There are few pages.
+  for (intptr_t i = 1; i < count; i++) {
+    Relocation relocation = relocations[i];
+    intptr_t j = i;
+    while ((j > 0) && (relocations[j - 1].start > relocation.start)) {
+      relocations[j] = relocations[j - 1];
+      j--;
+    }
+    relocations[j] = relocation;
+  }
+
+  // The free list links point into the source, so it is rebuilt from the
+  // copied elements.
+  freelist_.Reset();
+  for (HeapPage* page = pages_; page != NULL; page = page->next()) {
+    uword scan = page->object_start();
+    while (scan < page->object_end()) {
+      HeapObject* obj = HeapObject::FromAddr(scan);
+      intptr_t size = obj->HeapSize();
+      if (obj->cid() == kFreeListElementCid) {
+        freelist_.EnqueueRange(scan, size);
+      } else if (obj->cid() >= kFirstLegalCid) {
+        Object** from;
+        Object** to;
+        obj->Pointers(&from, &to);
+        for (Object** ptr = from; ptr <= to; ptr++) {
+          *ptr = Relocate(*ptr, relocations, count);
+        }
+      }
+      scan += size;
+    }
+  }
+  for (HeapPage* page = large_pages_; page != NULL; page = page->next()) {
+    HeapObject* obj = HeapObject::FromAddr(page->object_start());
+    if (obj->cid() >= kFirstLegalCid) {
+      Object** from;
+      Object** to;
+      obj->Pointers(&from, &to);
+      for (Object** ptr = from; ptr <= to; ptr++) {
+        *ptr = Relocate(*ptr, relocations, count);
+      }
+    }
+  }
+
+  if (class_table_capacity_ < source->class_table_capacity_) {
+    delete[] class_table_;
+    class_table_capacity_ = source->class_table_capacity_;
+    class_table_ = new Object*[class_table_capacity_];
+  }
+  for (intptr_t i = 0; i < source->class_table_capacity_; i++) {
+    class_table_[i] = Relocate(source->class_table_[i], relocations, count);
+  }
+  class_table_size_ = source->class_table_size_;
+  class_table_free_ = source->class_table_free_;
+
+  ObjectStore* object_store = static_cast<ObjectStore*>(
+      Relocate(source->interpreter_->object_store(), relocations, count));
+  free(relocations);
+
+  InitializeGrowthPolicy();
+  interpreter_->InitializeRoot(object_store);
+}
+
 void Heap::ForwardRoots() {
   for (intptr_t i = 0; i < handles_size_; i++) {
     ForwardPointer(handles_[i]);
   }
 
+  for (intptr_t i = 0; i < finalization_queue_size_; i++) {
+    ForwardPointer(reinterpret_cast<Object**>(&finalization_queue_[i]));
+  }
+
   Object** from;
   Object** to;
   interpreter_->RootPointers(&from, &to);
@@ -1178,6 +1905,62 @@ void Heap::ForwardHeap() {
       scan += obj->HeapSize();
     }
   }
+  for (HeapPage* page = large_pages_; page != NULL; page = page->next()) {
+    uword scan = page->object_start();
+    while (scan < page->object_end()) {
+      HeapObject* obj = HeapObject::FromAddr(scan);
+      if (obj->cid() >= kFirstLegalCid) {
+        ForwardClass(this, obj);
+        obj->set_is_remembered(false);
+        bool carded = IsCarded(obj);
+        if (carded) {
+          ClearCards(obj);
+        }
+        Object** from;
+        Object** to;
+        obj->Pointers(&from, &to);
+        for (Object** ptr = from; ptr <= to; ptr++) {
+          ForwardPointer(ptr);
+          if ((*ptr)->IsNewObject()) {
+            if (carded) {
+              MarkCard(obj, ptr);
+            } else if (!obj->is_remembered()) {
+              AddToRememberedSet(obj);
+            }
+          }
+        }
+      }
+      scan += obj->HeapSize();
+    }
+  }
+}
+
+void Heap::ForwardNewSpaceAndRememberedSet() {
+  uword scan = to_.object_start();
+  while (scan < top_) {
+    HeapObject* obj = HeapObject::FromAddr(scan);
+    if (obj->cid() >= kFirstLegalCid) {
+      Object** from;
+      Object** to;
+      obj->Pointers(&from, &to);
+      for (Object** ptr = from; ptr <= to; ptr++) {
+        ForwardPointer(ptr);
+      }
+    }
+    scan += obj->HeapSize();
+  }
+
+  // Entries stay remembered even if they now only refer to old forwardees;
+  // the next scavenge drops them.
+  for (intptr_t i = 0; i < remembered_set_size_; i++) {
+    HeapObject* obj = remembered_set_[i];
+    Object** from;
+    Object** to;
+    obj->Pointers(&from, &to);
+    for (Object** ptr = from; ptr <= to; ptr++) {
+      ForwardPointer(ptr);
+    }
+  }
 }
 
 void Heap::ForwardClassTable() {
@@ -1257,6 +2040,16 @@ intptr_t Heap::CountInstances(intptr_t cid) {
       scan += obj->HeapSize();
     }
   }
+  for (HeapPage* page = large_pages_; page != NULL; page = page->next()) {
+    uword scan = page->object_start();
+    while (scan < page->object_end()) {
+      HeapObject* obj = HeapObject::FromAddr(scan);
+      if (obj->cid() == cid) {
+        instances++;
+      }
+      scan += obj->HeapSize();
+    }
+  }
   return instances;
 }
 
@@ -1282,9 +2075,304 @@ intptr_t Heap::CollectInstances(intptr_t cid, Array* array) {
       scan += obj->HeapSize();
     }
   }
+  for (HeapPage* page = large_pages_; page != NULL; page = page->next()) {
+    uword scan = page->object_start();
+    while (scan < page->object_end()) {
+      HeapObject* obj = HeapObject::FromAddr(scan);
+      if (obj->cid() == cid) {
+        array->set_element(instances, obj);
+        instances++;
+      }
+      scan += obj->HeapSize();
+    }
+  }
   return instances;
 }
 
+void Heap::Census(intptr_t* counts, intptr_t* sizes) {
+  uword scan = to_.object_start();
+  while (scan < top_) {
+    HeapObject* obj = HeapObject::FromAddr(scan);
+    intptr_t size = obj->HeapSize();
+    if (obj->cid() >= kFirstLegalCid) {
+      counts[obj->cid()]++;
+      sizes[obj->cid()] += size;
+    }
+    scan += size;
+  }
+  for (HeapPage* page = pages_; page != NULL; page = page->next()) {
+    uword scan = page->object_start();
+    while (scan < page->object_end()) {
+      HeapObject* obj = HeapObject::FromAddr(scan);
+      intptr_t size = obj->HeapSize();
+      if (obj->cid() >= kFirstLegalCid) {
+        counts[obj->cid()]++;
+        sizes[obj->cid()] += size;
+      }
+      scan += size;
+    }
+  }
+  for (HeapPage* page = large_pages_; page != NULL; page = page->next()) {
+    uword scan = page->object_start();
+    while (scan < page->object_end()) {
+      HeapObject* obj = HeapObject::FromAddr(scan);
+      intptr_t size = obj->HeapSize();
+      if (obj->cid() >= kFirstLegalCid) {
+        counts[obj->cid()]++;
+        sizes[obj->cid()] += size;
+      }
+      scan += size;
+    }
+  }
+}
+
+// A heap dump is the magic "PSHD" followed by unsigned integers in the same
+// encoding as snapshots:
+//
+//   version
+//   number of objects, then for each object in address order:
+//     cid, heap size, number of references, object index of each reference
+//   number of classes, then for each class:
+//     cid, object index of the class, name length, name bytes
+//   number of roots, then the object index of each root
+//
+// An object's references include its class. The elements of WeakArrays are
+// omitted because they do not retain their targets.
+static const intptr_t kHeapDumpVersion = 1;
+
+class HeapDumpWriter {
+ public:
+  explicit HeapDumpWriter(FILE* file)
+      : file_(file), addresses_(NULL), length_(0), capacity_(0) {}
+  ~HeapDumpWriter() { free(addresses_); }
+
+  void AddObject(HeapObject* obj) {
+    if (length_ == capacity_) {
+      capacity_ = capacity_ == 0 ? 1024 : capacity_ * 2;
+      addresses_ = reinterpret_cast<uword*>(
+          realloc(addresses_, capacity_ * sizeof(uword)));
+    }
+    addresses_[length_++] = obj->Addr();
+  }
+
+  void SortObjects() {
+    qsort(addresses_, length_, sizeof(uword), CompareAddresses);
+  }
+
+  intptr_t num_objects() const { return length_; }
+  HeapObject* ObjectAt(intptr_t index) const {
+    return HeapObject::FromAddr(addresses_[index]);
+  }
+
+  bool IsDumped(Object* obj) const { return IndexOf(obj) != -1; }
+  intptr_t IndexOf(Object* obj) const {
+    if (!obj->IsHeapObject()) {
+      return -1;
+    }
+    uword addr = static_cast<HeapObject*>(obj)->Addr();
+    intptr_t low = 0;
+    intptr_t high = length_ - 1;
+    while (low <= high) {
+      intptr_t mid = low + (high - low) / 2;
+      if (addresses_[mid] < addr) {
+        low = mid + 1;
+      } else if (addresses_[mid] > addr) {
+        high = mid - 1;
+      } else {
+        return mid;
+      }
+    }
+    return -1;
+  }
+
+  void WriteBytes(const void* bytes, intptr_t length) {
+    fwrite(bytes, 1, length, file_);
+  }
+
+  void WriteUnsigned(uword value) {
+    while (value > kMaxUnsignedDataPerByte) {
+      fputc(value & kMaxUnsignedDataPerByte, file_);
+      value >>= kDataBitsPerByte;
+    }
+    fputc(value + kEndUnsignedByteMarker, file_);
+  }
+
+ private:
+  static const intptr_t kDataBitsPerByte = 7;
+  static const uword kMaxUnsignedDataPerByte = (1 << kDataBitsPerByte) - 1;
+  static const uword kEndUnsignedByteMarker = 255 - kMaxUnsignedDataPerByte;
+
+  static int CompareAddresses(const void* a, const void* b) {
+    uword left = *reinterpret_cast<const uword*>(a);
+    uword right = *reinterpret_cast<const uword*>(b);
+    return (left > right) - (left < right);
+  }
+
+  FILE* file_;
+  uword* addresses_;
+  intptr_t length_;
+  intptr_t capacity_;
+
+  DISALLOW_COPY_AND_ASSIGN(HeapDumpWriter);
+};
+
+static void WriteClassName(HeapDumpWriter* writer, Heap* heap,
+                           Behavior* cls) {
+  Behavior* theMetaclass = heap->ClassAt(kSmiCid)->Klass(heap)->Klass(heap);
+  String* name;
+  const char* suffix = "";
+  if (cls->Klass(heap) == theMetaclass) {
+    name = static_cast<Metaclass*>(cls)->this_class()->name();
+    suffix = " class";
+  } else {
+    name = static_cast<Class*>(cls)->name();
+  }
+  if (!name->IsString()) {
+    const char* unknown = "?";
+    writer->WriteUnsigned(strlen(unknown));
+    writer->WriteBytes(unknown, strlen(unknown));
+    return;
+  }
+  writer->WriteUnsigned(name->Size() + strlen(suffix));
+  writer->WriteBytes(name->element_addr(0), name->Size());
+  writer->WriteBytes(suffix, strlen(suffix));
+}
+
+bool Heap::DumpGraph(const char* filename) {
+  FILE* file = fopen(filename, "wb");
+  if (file == NULL) {
+    return false;
+  }
+
+  HeapDumpWriter writer(file);
+  uword scan = to_.object_start();
+  while (scan < top_) {
+    HeapObject* obj = HeapObject::FromAddr(scan);
+    if (obj->cid() >= kFirstLegalCid) {
+      writer.AddObject(obj);
+    }
+    scan += obj->HeapSize();
+  }
+  for (HeapPage* page = pages_; page != NULL; page = page->next()) {
+    uword scan = page->object_start();
+    while (scan < page->object_end()) {
+      HeapObject* obj = HeapObject::FromAddr(scan);
+      if (obj->cid() >= kFirstLegalCid) {
+        writer.AddObject(obj);
+      }
+      scan += obj->HeapSize();
+    }
+  }
+  for (HeapPage* page = large_pages_; page != NULL; page = page->next()) {
+    uword scan = page->object_start();
+    while (scan < page->object_end()) {
+      HeapObject* obj = HeapObject::FromAddr(scan);
+      if (obj->cid() >= kFirstLegalCid) {
+        writer.AddObject(obj);
+      }
+      scan += obj->HeapSize();
+    }
+  }
+  writer.SortObjects();
+
+  writer.WriteBytes("PSHD", 4);
+  writer.WriteUnsigned(kHeapDumpVersion);
+
+  intptr_t num_objects = writer.num_objects();
+  writer.WriteUnsigned(num_objects);
+  for (intptr_t i = 0; i < num_objects; i++) {
+    HeapObject* obj = writer.ObjectAt(i);
+    writer.WriteUnsigned(obj->cid());
+    writer.WriteUnsigned(obj->HeapSize());
+
+    Object** from;
+    Object** to;
+    obj->Pointers(&from, &to);
+    if (obj->IsWeakArray()) {
+      from = to + 1;
+    }
+    Object* cls = ClassAt(obj->cid());
+    intptr_t num_refs = writer.IsDumped(cls) ? 1 : 0;
+    for (Object** ptr = from; ptr <= to; ptr++) {
+      if (writer.IsDumped(*ptr)) {
+        num_refs++;
+      }
+    }
+    writer.WriteUnsigned(num_refs);
+    if (writer.IsDumped(cls)) {
+      writer.WriteUnsigned(writer.IndexOf(cls));
+    }
+    for (Object** ptr = from; ptr <= to; ptr++) {
+      if (writer.IsDumped(*ptr)) {
+        writer.WriteUnsigned(writer.IndexOf(*ptr));
+      }
+    }
+  }
+
+  intptr_t num_classes = 0;
+  for (intptr_t cid = kFirstLegalCid; cid < class_table_size_; cid++) {
+    if (writer.IsDumped(class_table_[cid])) {
+      num_classes++;
+    }
+  }
+  writer.WriteUnsigned(num_classes);
+  for (intptr_t cid = kFirstLegalCid; cid < class_table_size_; cid++) {
+    Object* cls = class_table_[cid];
+    if (writer.IsDumped(cls)) {
+      writer.WriteUnsigned(cid);
+      writer.WriteUnsigned(writer.IndexOf(cls));
+      WriteClassName(&writer, this, static_cast<Behavior*>(cls));
+    }
+  }
+
+  interpreter_->GCPrologue();  // Hide IPs on the stack.
+  intptr_t num_roots = 0;
+  Object** from;
+  Object** to;
+  for (intptr_t i = 0; i < handles_size_; i++) {
+    if (writer.IsDumped(*handles_[i])) num_roots++;
+  }
+  for (intptr_t i = 0; i < finalization_queue_size_; i++) {
+    if (writer.IsDumped(finalization_queue_[i])) num_roots++;
+  }
+  interpreter_->RootPointers(&from, &to);
+  for (Object** ptr = from; ptr <= to; ptr++) {
+    if (writer.IsDumped(*ptr)) num_roots++;
+  }
+  interpreter_->StackPointers(&from, &to);
+  for (Object** ptr = from; ptr <= to; ptr++) {
+    if (writer.IsDumped(*ptr)) num_roots++;
+  }
+  writer.WriteUnsigned(num_roots);
+  for (intptr_t i = 0; i < handles_size_; i++) {
+    if (writer.IsDumped(*handles_[i])) {
+      writer.WriteUnsigned(writer.IndexOf(*handles_[i]));
+    }
+  }
+  for (intptr_t i = 0; i < finalization_queue_size_; i++) {
+    if (writer.IsDumped(finalization_queue_[i])) {
+      writer.WriteUnsigned(writer.IndexOf(finalization_queue_[i]));
+    }
+  }
+  interpreter_->RootPointers(&from, &to);
+  for (Object** ptr = from; ptr <= to; ptr++) {
+    if (writer.IsDumped(*ptr)) {
+      writer.WriteUnsigned(writer.IndexOf(*ptr));
+    }
+  }
+  interpreter_->StackPointers(&from, &to);
+  for (Object** ptr = from; ptr <= to; ptr++) {
+    if (writer.IsDumped(*ptr)) {
+      writer.WriteUnsigned(writer.IndexOf(*ptr));
+    }
+  }
+  interpreter_->GCEpilogue();
+
+  bool success = ferror(file) == 0;
+  fclose(file);
+  return success;
+}
+
 uword FreeList::TryAllocate(intptr_t size) {
   intptr_t index = IndexForSize(size);
   while (index < kSizeClasses) {
@@ -36,18 +36,8 @@ class Semispace {
  private:
   friend class Heap;
 
-  void Allocate(size_t size) {
-    memory_ = VirtualMemory::Allocate(size,
-                                      VirtualMemory::kReadWrite,
-                                      "primordialsoup-heap");
-    ASSERT(Utils::IsAligned(memory_.base(), kObjectAlignment));
-    ASSERT(memory_.size() == size);
-#if defined(DEBUG)
-    MarkUnallocated();
-#endif
-  }
-
-  void Free() { memory_.Free(); }
+  void Allocate(size_t size);
+  void Free();
 
   size_t size() const { return memory_.size(); }
   uword base() const { return memory_.base(); }
@@ -103,12 +93,24 @@ class FreeList {
 //
 // Barry Hayes. "Ephemerons: a New Finalization Mechanism." Object-Oriented
 // Languages, Programming, Systems, and Applications. 1997.
+//
+// David Ungar and Frank Jackson. "Tenuring Policies for Generation-Based
+// Storage Reclamation." Object-Oriented Programming, Systems, Languages, and
+// Applications. 1988.
 class Heap {
  private:
   static const intptr_t kLargeAllocation = 32 * KB;
+  static const intptr_t kCardSizeLog2 = 9;
+  static const intptr_t kCardSize = 1 << kCardSizeLog2;
   static const size_t kInitialSemispaceCapacity = sizeof(uword) * MB / 8;
   static const size_t kMaxSemispaceCapacity = 2 * sizeof(uword) * MB;
   static const size_t kPageSize = 256 * KB;
+  static const size_t kLargePageCacheCapacity = 32 * MB;
+  // Once OutOfMemory has been signaled, its handlers may grow the heap by
+  // this fraction of the hard limit before it is signaled again.
+  static const size_t kHardLimitSlackFraction = 8;
+  static const intptr_t kMaxTenureAge = (1 << kAgeFieldSize) - 1;
+  static const intptr_t kDefaultMaxTenureAge = 3;
 
  public:
   enum Allocator { kNormal, kSnapshot };
@@ -137,9 +139,28 @@ class Heap {
     return NULL;
   }
 
+  // Only the sizes every heap starts out with go through the page pool.
+  // Grown semispaces and large-object pages seldom match a later request
+  // and would only push the common sizes out.
+  static bool IsPooledSize(size_t size) {
+    return (size == kInitialSemispaceCapacity) || (size == kPageSize);
+  }
+
   Heap();
   ~Heap();
 
+  // Sets the limits of heaps created afterwards, in bytes of objects, or 0 for
+  // no limit. Crossing the soft limit is reported to the program through
+  // TakeMemoryPressure. Growing past the hard limit makes the interpreter
+  // signal an out-of-memory exception.
+  static void SetLimits(size_t soft_limit, size_t hard_limit);
+
+  // Sets the scavenger policy of heaps created afterwards. New space is
+  // shrunk when a scavenge takes longer than pause_goal nanoseconds, or 0 for
+  // no goal. Objects are tenured after surviving at most max_tenure_age
+  // scavenges, or the default if 0.
+  static void SetScavengePolicy(int64_t pause_goal, intptr_t max_tenure_age);
+
   void AddToRememberedSet(HeapObject* object) {
     ASSERT(object->IsOldObject());
     ASSERT(!object->is_remembered());
@@ -150,6 +171,15 @@ class Heap {
     object->set_is_remembered(true);
   }
 
+  // Called by the write barrier when a new object is stored into an old one.
+  void RememberStore(HeapObject* object, Object** slot) {
+    if (IsCarded(object)) {
+      MarkCard(object, slot);
+    } else {
+      AddToRememberedSet(object);
+    }
+  }
+
   RegularObject* AllocateRegularObject(intptr_t cid, intptr_t num_slots,
                                        Allocator allocator = kNormal) {
     ASSERT(cid == kEphemeronCid || cid >= kFirstRegularObjectCid);
@@ -282,13 +312,66 @@ class Heap {
     return new_size + old_size_;
   }
 
+  // Total bytes allocated by the program, not counting objects copied or
+  // tenured by the GC. Sampled to compute allocation rates.
+  int64_t AllocatedBytes() const {
+    return allocated_bytes_ + (top_ - survivor_end_);
+  }
+
   void CollectAll(Reason reason) { MarkSweep(reason); }
 
+  // Collections so far and their total time in nanoseconds.
+  int64_t scavenge_count() const { return scavenge_count_; }
+  int64_t scavenge_time() const { return scavenge_time_; }
+  int64_t mark_sweep_count() const { return mark_sweep_count_; }
+  int64_t mark_sweep_time() const { return mark_sweep_time_; }
+  // Answers the longest pause in nanoseconds since the last call.
+  int64_t TakeLongestPause() {
+    int64_t result = longest_pause_;
+    longest_pause_ = 0;
+    return result;
+  }
+
   intptr_t CountInstances(intptr_t cid);
   intptr_t CollectInstances(intptr_t cid, Array* array);
 
+  // Accumulates the number and total size of instances of each cid into
+  // arrays of class_table_size() elements, in one pass over both spaces.
+  void Census(intptr_t* counts, intptr_t* sizes);
+  bool DumpGraph(const char* filename);
+
   bool BecomeForward(Array* old, Array* neu);
 
+  // Fills this newly created heap with a copy of a heap that has just been
+  // deserialized and not run, relocating every pointer, and initializes the
+  // interpreter's roots from it, which is cheaper than deserializing again.
+  void CloneFrom(Heap* source);
+
+  // Gives up the part of object past new_heap_size, leaving the heap walkable.
+  // The caller must then reinitialize the object's header and size.
+  void Shrink(HeapObject* object, intptr_t new_heap_size);
+
+  // Answers an Array of the ephemerons that fired with a finalizer since the
+  // last call, or nil if there are none. SAFEPOINT
+  Object* TakeFinalizationQueue();
+
+  // Replaces this heap's limits. The next collection checks them as if
+  // neither had been crossed yet.
+  void ChangeLimits(size_t soft_limit, size_t hard_limit) {
+    soft_limit_ = soft_limit;
+    hard_limit_ = hard_limit;
+    over_soft_limit_ = false;
+    over_hard_limit_ = false;
+  }
+
+  // Answers whether a collection found the heap above its soft limit since
+  // the last call. Reported once per crossing.
+  bool TakeMemoryPressure() {
+    bool result = memory_pressure_;
+    memory_pressure_ = false;
+    return result;
+  }
+
   intptr_t AllocateClassId();
   void RegisterClass(intptr_t cid, Behavior* cls) {
     ASSERT(class_table_[cid] == reinterpret_cast<Object*>(kUninitializedWord));
@@ -297,6 +380,7 @@ class Heap {
     cls->AssertCouldBeBehavior();
     ASSERT(cls->cid() >= kFirstRegularObjectCid);
   }
+  intptr_t class_table_size() const { return class_table_size_; }
   Behavior* ClassAt(intptr_t cid) const {
     ASSERT(cid > kIllegalCid);
     ASSERT(cid < class_table_size_);
@@ -319,6 +403,40 @@ class Heap {
   void GrowRememberedSet();
   void ShrinkRememberedSet();
 
+  // Large Arrays remember stores by card, so a scavenge rescans only the
+  // parts of them that were written rather than the whole object. They are
+  // kept in the remembered set but never have the remembered bit, so every
+  // store of a new object into them reaches RememberStore. The card table
+  // follows the object on its large page: a byte for whether the object is in
+  // the remembered set, then a byte per kCardSize bytes of the object.
+  static bool IsCarded(HeapObject* object) {
+    return (object->cid() == kArrayCid) &&
+        (object->HeapSize() >= kLargeAllocation);
+  }
+  static intptr_t CardTableSize(intptr_t heap_size) {
+    return 1 + ((heap_size + kCardSize - 1) >> kCardSizeLog2);
+  }
+  static uint8_t* CardTable(HeapObject* object) {
+    return reinterpret_cast<uint8_t*>(object->Addr() + object->HeapSize());
+  }
+  void MarkCard(HeapObject* object, Object** slot) {
+    ASSERT(object->IsOldObject());
+    uint8_t* cards = CardTable(object);
+    cards[1 + ((reinterpret_cast<uword>(slot) - object->Addr()) >>
+               kCardSizeLog2)] = 1;
+    if (cards[0] == 0) {
+      if (remembered_set_size_ == remembered_set_capacity_) {
+        GrowRememberedSet();
+      }
+      remembered_set_[remembered_set_size_++] = object;
+      cards[0] = 1;
+    }
+  }
+  void ClearCards(HeapObject* object) {
+    memset(CardTable(object), 0, CardTableSize(object->HeapSize()));
+  }
+  void ScavengeCards(HeapObject* object);
+
   // Scavenging.
   void Scavenge(Reason reason);
   void FlipSpaces();
@@ -329,6 +447,9 @@ class Heap {
   bool IsTenureStackEmpty();
   void ProcessTenureStack();
   void ScavengePointer(Object** ptr);
+  HeapObject* Evacuate(HeapObject* old_target);
+  void AdjustScavengePolicy(size_t survived, int64_t pause);
+  size_t MaxSemispaceCapacity() const;
   void ScavengeOldObject(HeapObject* obj);
   void ScavengeClass(intptr_t cid);
 
@@ -339,13 +460,29 @@ class Heap {
   void ProcessMarkStack();
   void Sweep();
   bool SweepPage(HeapPage* page);
+  void SweepLargePages();
   void SetOldAllocationLimit();
+  void CheckLimits();
+  bool ExceedsHardLimit(size_t growth) const {
+    if (hard_limit_ == 0) {
+      return false;
+    }
+    size_t limit = hard_limit_;
+    if (over_hard_limit_) {
+      limit += hard_limit_ / kHardLimitSlackFraction;
+    }
+    return Size() + growth > limit;
+  }
+  void SignalOutOfMemory();
 
   // Ephemerons.
   void AddToEphemeronList(Ephemeron* ephemeron_corpse);
   void ScavengeEphemeronList();
   void MarkEphemeronList();
   void MournEphemeronList();
+  bool FinalizeEphemeronListScavenge();
+  bool FinalizeEphemeronListMarkSweep();
+  void AddToFinalizationQueue(Ephemeron* ephemeron);
 
   // WeakArrays.
   void AddToWeakList(WeakArray* survivor);
@@ -361,7 +498,19 @@ class Heap {
   // Become.
   void ForwardRoots();
   void ForwardHeap();
+  void ForwardNewSpaceAndRememberedSet();
   void ForwardClassTable();
+  void ForwardPointer(Object** ptr) {
+    // Most pointers are filtered by address without loading the target's
+    // header.
+    uword target = reinterpret_cast<uword>(*ptr);
+    if ((target >= forwarding_low_) && (target <= forwarding_high_) &&
+        (*ptr)->IsForwardingCorpse()) {
+      Object* new_target = static_cast<ForwardingCorpse*>(*ptr)->target();
+      ASSERT(!new_target->IsForwardingCorpse());
+      *ptr = new_target;
+    }
+  }
 
   uword TryAllocateNew(intptr_t size) {
     uword result = top_;
@@ -385,7 +534,15 @@ class Heap {
     if (size >= kLargeAllocation) {
       return AllocateOldLarge(size, kControlGrowth);
     }
-    return AllocateNew(size);
+    // Fast path: bump the new-space top. Only the slow path is out-of-line.
+    uword addr = TryAllocateNew(size);
+    if (addr == 0) {
+      return AllocateNew(size);
+    }
+#if defined(DEBUG)
+    memset(reinterpret_cast<void*>(addr), kUninitializedByte, size);
+#endif
+    return addr;
   }
 
   uword AllocateNew(intptr_t size);
@@ -396,6 +553,9 @@ class Heap {
   uword AllocateSnapshotLarge(intptr_t size);
 
   HeapPage* AllocatePage(intptr_t page_size, GrowthPolicy growth);
+  HeapPage* AllocateLargePage(intptr_t size, GrowthPolicy growth);
+  HeapPage* TakeCachedLargePage(intptr_t page_size);
+  void ReleaseLargePage(HeapPage* page);
 
 #if defined(DEBUG)
   bool InFromSpace(HeapObject* obj) {
@@ -413,6 +573,20 @@ class Heap {
   Semispace to_;
   Semispace from_;
   size_t next_semispace_capacity_;
+  // Objects surviving a scavenge at this age or older are tenured. Adjusted
+  // after each scavenge from how many survivors survive again.
+  intptr_t tenure_age_;
+  size_t survivor_bytes_[kMaxTenureAge + 1];  // By age, in the last scavenge.
+  size_t aged_survivor_bytes_;  // Survived the last scavenge and this one.
+  size_t last_survivor_bytes_;  // Left in new space by the last scavenge.
+  intptr_t low_survival_count_;
+  static int64_t default_pause_goal_;
+  static intptr_t default_max_tenure_age_;
+  const int64_t pause_goal_;
+  const intptr_t max_tenure_age_;
+  // Bytes allocated before the last scavenge. New space allocations are only
+  // added here when they are scavenged, so the fast path does no counting.
+  int64_t allocated_bytes_;
 
   // Old space.
   HeapPage* pages_;
@@ -421,6 +595,34 @@ class Heap {
   size_t old_capacity_;
   size_t old_limit_;
 
+  // Large-object space. Each page holds a single object of at least
+  // kLargeAllocation bytes. Its size and capacity are also counted in
+  // old_size_ and old_capacity_. Dead pages have their memory returned to the
+  // OS and are kept for reuse until the cache is full.
+  HeapPage* large_pages_;
+  HeapPage* cached_large_pages_;
+  size_t large_size_;
+  size_t large_capacity_;
+  size_t cached_large_capacity_;
+
+  // Limits on Size(), or 0. The over flags are cleared when a collection
+  // finds the heap back under the limit, so each crossing is reported once
+  // and the program can allocate while it handles the report.
+  static size_t default_soft_limit_;
+  static size_t default_hard_limit_;
+  size_t soft_limit_;
+  size_t hard_limit_;
+  bool over_soft_limit_;
+  bool over_hard_limit_;
+  bool memory_pressure_;
+
+  // Statistics.
+  int64_t scavenge_count_;
+  int64_t scavenge_time_;
+  int64_t mark_sweep_count_;
+  int64_t mark_sweep_time_;
+  int64_t longest_pause_;
+
   // Remembered set.
   HeapObject** remembered_set_;
   intptr_t remembered_set_size_;
@@ -442,6 +644,16 @@ class Heap {
   Ephemeron* ephemeron_list_;
   WeakArray* weak_list_;
 
+  // Ephemerons whose keys died while they had a finalizer. They are strong
+  // roots until the program takes them.
+  Ephemeron** finalization_queue_;
+  intptr_t finalization_queue_size_;
+  intptr_t finalization_queue_capacity_;
+
+  // Range of the forwarders during a become.
+  uword forwarding_low_;
+  uword forwarding_high_;
+
   DISALLOW_COPY_AND_ASSIGN(Heap);
 };
 
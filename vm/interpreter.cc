@@ -111,12 +111,27 @@ static Activation* FrameBaseSender(Object** fp) {
   return static_cast<Activation*>(fp[1]);
 }
 
+intptr_t Interpreter::configured_stack_slots_ = kDefaultStackSlots;
+
+
+void Interpreter::SetStackSize(intptr_t size) {
+  intptr_t slots = size / sizeof(Object*);
+  if (slots < kMinStackSlots) {
+    slots = kMinStackSlots;
+  }
+  configured_stack_slots_ = slots;
+}
+
+
 Interpreter::Interpreter(Heap* heap, Isolate* isolate) :
+    stack_slots_(configured_stack_slots_),
     ip_(NULL),
     sp_(NULL),
     fp_(NULL),
     stack_base_(NULL),
     stack_limit_(NULL),
+    interrupted_(false),
+    out_of_memory_(false),
     nil_(NULL),
     false_(NULL),
     true_(NULL),
@@ -126,22 +141,111 @@ Interpreter::Interpreter(Heap* heap, Isolate* isolate) :
     environment_(NULL) {
   heap->InitializeInterpreter(this);
 
-  stack_limit_ = reinterpret_cast<Object**>(malloc(kStackSize));
-  stack_base_ = stack_limit_ + kStackSlots;
+  stack_limit_ = reinterpret_cast<Object**>(
+      malloc(stack_slots_ * sizeof(Object*)));
+  stack_base_ = stack_limit_ + stack_slots_;
   sp_ = stack_base_;
   checked_stack_limit_ = stack_limit_ + (sizeof(Activation) / sizeof(Object*));
 
 #if defined(DEBUG)
-  memset(stack_limit_, kUninitializedByte, kStackSize);
+  memset(stack_limit_, kUninitializedByte, stack_slots_ * sizeof(Object*));
 #endif
+
+  memset(bytecode_counts_, 0, sizeof(bytecode_counts_));
+  memset(primitive_counts_, 0, sizeof(primitive_counts_));
+  memset(send_hits_, 0, sizeof(send_hits_));
+  memset(send_misses_, 0, sizeof(send_misses_));
+  memset(flush_counts_, 0, sizeof(flush_counts_));
+  frames_flushed_ = 0;
 }
 
 
 Interpreter::~Interpreter() {
+  if (COUNT_EXECUTIONS) {
+    PrintExecutionCounters();
+  }
   free(stack_limit_);
 }
 
 
+int64_t Interpreter::ExecutionCounterAt(intptr_t index) const {
+  ASSERT(index >= 0 && index < kNumExecutionCounters);
+  if (index < kNumBytecodes) {
+    return bytecode_counts_[index];
+  }
+  index -= kNumBytecodes;
+  if (index < Primitives::kNumPrimitives) {
+    return primitive_counts_[index];
+  }
+  index -= Primitives::kNumPrimitives;
+  if (index < kNumSendKinds) {
+    return send_hits_[index];
+  }
+  index -= kNumSendKinds;
+  if (index < kNumSendKinds) {
+    return send_misses_[index];
+  }
+  index -= kNumSendKinds;
+  if (index < kNumFlushKinds) {
+    return flush_counts_[index];
+  }
+  return frames_flushed_;
+}
+
+
+static void PrintSortedCounts(const char* label,
+                              const int64_t* counts,
+                              intptr_t length) {
+  int64_t total = 0;
+  intptr_t* order = new intptr_t[length];
+  intptr_t used = 0;
+  for (intptr_t i = 0; i < length; i++) {
+    if (counts[i] == 0) continue;
+    total += counts[i];
+    // Insertion sort, descending by count.
+    intptr_t j = used++;
+    while ((j > 0) && (counts[order[j - 1]] < counts[i])) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+
+  OS::PrintErr("%s: %" Pd64 " total\n", label, total);
+  for (intptr_t i = 0; i < used; i++) {
+    int64_t count = counts[order[i]];
+    OS::PrintErr("  %3" Pd " %15" Pd64 " %6.2lf%%\n",
+                 order[i], count, 100.0 * count / total);
+  }
+  delete[] order;
+}
+
+
+void Interpreter::PrintExecutionCounters() {
+  OS::PrintErr("Execution counters for %" Px "\n",
+               reinterpret_cast<uword>(isolate_));
+  PrintSortedCounts("Bytecodes", bytecode_counts_, kNumBytecodes);
+  PrintSortedCounts("Primitives", primitive_counts_,
+                    Primitives::kNumPrimitives);
+
+  static const char* kSendKindNames[kNumSendKinds] = {
+    "Ordinary", "Super", "ImplicitReceiver", "Outer", "Self", "Lexical",
+  };
+  OS::PrintErr("Sends: %16s %15s %15s %7s\n", "", "hits", "misses", "hit%");
+  for (intptr_t i = 0; i < kNumSendKinds; i++) {
+    int64_t lookups = send_hits_[i] + send_misses_[i];
+    OS::PrintErr("  %-20s %15" Pd64 " %15" Pd64 " %6.2lf%%\n",
+                 kSendKindNames[i], send_hits_[i], send_misses_[i],
+                 lookups == 0 ? 0.0 : 100.0 * send_hits_[i] / lookups);
+  }
+  OS::PrintErr("Flushes: %" Pd64 " full, %" Pd64 " partial, "
+               "%" Pd64 " frames\n",
+               flush_counts_[kFullFlush], flush_counts_[kPartialFlush],
+               frames_flushed_);
+  OS::PrintErr("Allocated: %" Pd64 " bytes\n", heap_->AllocatedBytes());
+}
+
+
 void Interpreter::PushLiteralVariable(intptr_t offset) {
   // Not used in Newspeak, except by the implementation of eventual sends.
   // TODO(rmacnak): Add proper eventual send bytecode.
@@ -245,6 +349,38 @@ void Interpreter::PushNewArray(intptr_t size) {
 }
 
 
+void Interpreter::PopNAndPushFloat64(intptr_t n, double value) {
+  Float64* result = H->AllocateFloat64();  // SAFEPOINT
+  result->set_value(value);
+  PopNAndPush(n, result);
+}
+
+
+// Answers whether one operand is a Float64 and the other a Float64 or
+// SmallInteger, the mixes the special selector bytecodes handle inline.
+static inline bool FloatOperands(Object* left, Object* right,
+                                 double* raw_left, double* raw_right) {
+  if (left->IsFloat64()) {
+    *raw_left = static_cast<Float64*>(left)->value();
+    if (right->IsFloat64()) {
+      *raw_right = static_cast<Float64*>(right)->value();
+      return true;
+    }
+    if (right->IsSmallInteger()) {
+      *raw_right = static_cast<SmallInteger*>(right)->value();
+      return true;
+    }
+    return false;
+  }
+  if (left->IsSmallInteger() && right->IsFloat64()) {
+    *raw_left = static_cast<SmallInteger*>(left)->value();
+    *raw_right = static_cast<Float64*>(right)->value();
+    return true;
+  }
+  return false;
+}
+
+
 void Interpreter::PushClosure(intptr_t num_copied,
                               intptr_t num_args,
                               intptr_t block_size) {
@@ -318,11 +454,17 @@ void Interpreter::OrdinarySend(String* selector,
 #if LOOKUP_CACHE
   Method* target;
   if (lookup_cache_.LookupOrdinary(receiver->ClassId(), selector, &target)) {
+    if (COUNT_EXECUTIONS) {
+      CountSend(kOrdinarySend, true);
+    }
     Activate(target, num_args);  // SAFEPOINT
     return;
   }
 #endif
 
+  if (COUNT_EXECUTIONS) {
+    CountSend(kOrdinarySend, false);
+  }
   OrdinarySendMiss(selector, num_args);  // SAFEPOINT
 }
 
@@ -384,11 +526,17 @@ void Interpreter::SuperSend(intptr_t selector_index,
                              &target)) {
     ASSERT(absent_receiver == 0);
     absent_receiver = receiver;
+    if (COUNT_EXECUTIONS) {
+      CountSend(kSuperSend, true);
+    }
     ActivateAbsent(target, receiver, num_args);  // SAFEPOINT
     return;
   }
 #endif
 
+  if (COUNT_EXECUTIONS) {
+    CountSend(kSuperSend, false);
+  }
   SuperSendMiss(selector, num_args);  // SAFEPOINT
 }
 
@@ -425,11 +573,17 @@ void Interpreter::ImplicitReceiverSend(intptr_t selector_index,
     if (absent_receiver == 0) {
       absent_receiver = method_receiver;
     }
+    if (COUNT_EXECUTIONS) {
+      CountSend(kImplicitReceiverSend, true);
+    }
     ActivateAbsent(target, absent_receiver, num_args);  // SAFEPOINT
     return;
   }
 #endif
 
+  if (COUNT_EXECUTIONS) {
+    CountSend(kImplicitReceiverSend, false);
+  }
   return ImplicitReceiverSendMiss(selector, num_args);  // SAFEPOINT
 }
 
@@ -481,11 +635,17 @@ void Interpreter::OuterSend(intptr_t selector_index,
                              &absent_receiver,
                              &target)) {
     ASSERT(absent_receiver != 0);
+    if (COUNT_EXECUTIONS) {
+      CountSend(kOuterSend, true);
+    }
     ActivateAbsent(target, absent_receiver, num_args);  // SAFEPOINT
     return;
   }
 #endif
 
+  if (COUNT_EXECUTIONS) {
+    CountSend(kOuterSend, false);
+  }
   OuterSendMiss(selector, num_args, depth);  // SAFEPOINT
 }
 
@@ -522,11 +682,17 @@ void Interpreter::SelfSend(intptr_t selector_index,
                              &absent_receiver,
                              &target)) {
     ASSERT(absent_receiver == 0);
+    if (COUNT_EXECUTIONS) {
+      CountSend(kSelfSend, true);
+    }
     ActivateAbsent(target, receiver, num_args);  // SAFEPOINT
     return;
   }
 #endif
 
+  if (COUNT_EXECUTIONS) {
+    CountSend(kSelfSend, false);
+  }
   SelfSendMiss(selector, num_args);  // SAFEPOINT
 }
 
@@ -547,6 +713,11 @@ void Interpreter::LexicalSend(String* selector,
   Behavior* receiver_class = receiver->Klass(H);
   Behavior* mixin_application = FindApplicationOf(mixin, receiver_class);
   Method* method = MethodAt(mixin_application, selector);
+  if (COUNT_EXECUTIONS) {
+    // Not a cache: a hit is resolved at the lexical level, a miss falls back
+    // to the protected lookup.
+    CountSend(kLexicalSend, method != nil && method->IsPrivate());
+  }
   if (method != nil && method->IsPrivate()) {
 #if LOOKUP_CACHE
     Object* method_receiver = FrameReceiver(fp_);
@@ -755,6 +926,46 @@ void Interpreter::SendNonBooleanReceiver(Object* non_boolean) {
 }
 
 
+void Interpreter::SendOutOfMemory() {
+  if (TRACE_SPECIAL_CONTROL) {
+    OS::PrintErr("#outOfMemory\n");
+  }
+
+  String* selector = object_store()->out_of_memory();
+  if (selector == NULL) {
+    FATAL("Out of memory");  // Snapshot predates #outOfMemory.
+  }
+
+  // Discard the frame just created, so the send that created it answers the
+  // result of #outOfMemory.
+  ip_ = FrameSavedIP(fp_);
+  sp_ = FrameSavedSP(fp_);
+  fp_ = FrameSavedFP(fp_);
+  ASSERT(fp_ != 0);
+
+  Activation* top = EnsureActivation(fp_);  // SAFEPOINT
+  selector = object_store()->out_of_memory();
+
+  Behavior* receiver_class = top->Klass(H);
+  Behavior* cls = receiver_class;
+  Method* method;
+  do {
+    method = MethodAt(cls, selector);
+    if (method != nil) {
+      break;
+    }
+    cls = cls->superclass();
+  } while (cls != nil);
+
+  if (method == nil) {
+    FATAL("Missing #outOfMemory");
+  }
+
+  Push(top);
+  Activate(method, 0);  // SAFEPOINT
+}
+
+
 void Interpreter::InsertAbsentReceiver(Object* receiver, intptr_t num_args) {
   ASSERT(num_args >= 0);
   ASSERT(num_args < 255);
@@ -923,14 +1134,28 @@ void Interpreter::CreateBaseFrame(Activation* activation) {
 
 void Interpreter::StackOverflow() {
   if (checked_stack_limit_ == reinterpret_cast<Object**>(-1)) {
-    // Interrupt.
-    isolate_->PrintStack();
-    Exit();
+    if (interrupted_) {
+      isolate_->PrintStack();
+      Exit();
+    }
+    ASSERT(out_of_memory_);
+    out_of_memory_ = false;
+    checked_stack_limit_ =
+        stack_limit_ + (sizeof(Activation) / sizeof(Object*));
+    // An interrupt that arrived since the check above must not be lost by
+    // resetting the limit. Interrupt sets the flag before the limit.
+    if (interrupted_) {
+      checked_stack_limit_ = reinterpret_cast<Object**>(-1);
+    }
+    SendOutOfMemory();  // SAFEPOINT
+    return;
   }
 
-  // True overflow: reclaim stack space by moving all frames except the top
-  // frame to the heap.
-  CreateBaseFrame(FlushAllFrames());  // SAFEPOINT
+  // True overflow: reclaim stack space by moving the oldest frames to the
+  // heap, or all frames except the top frame if it is itself large.
+  if (!FlushOldestFrames()) {  // SAFEPOINT
+    CreateBaseFrame(FlushAllFrames());  // SAFEPOINT
+  }
 }
 
 
@@ -960,25 +1185,31 @@ void Interpreter::LocalReturn(Object* result) {
 
 void Interpreter::LocalBaseReturn(Object* result) {
   // Returning from the base frame.
+  Activation* sender = FrameBaseSender(fp_);
+  if (sender->IsActivation() && sender->bci()->IsSmallInteger()) {
+    // Resume the sender without first moving the returning frame to an
+    // activation. This is the common case when unwinding deep recursion.
+    Activation* top = FrameActivation(fp_);
+    if (top != 0) {
+      top->set_sender(static_cast<Activation*>(nil), kNoBarrier);
+      top->set_bci(static_cast<SmallInteger*>(nil));
+    }
+    ip_ = 0;
+    sp_ = stack_base_;
+    fp_ = 0;
+    CreateBaseFrame(sender);
+    Push(result);
+    return;
+  }
+
+  // The sender is dead or absent.
   Activation* top;
   {
     HandleScope h(H, reinterpret_cast<Object**>(&result));
     top = FlushAllFrames();  // SAFEPOINT
   }
-
-  Activation* sender = top->sender();
-  if (!sender->IsActivation() ||
-      !sender->bci()->IsSmallInteger()) {
-    CreateBaseFrame(top);
-    SendCannotReturn(result);  // SAFEPOINT
-    return;
-  }
-
-  top->set_sender(static_cast<Activation*>(nil), kNoBarrier);
-  top->set_bci(static_cast<SmallInteger*>(nil));
-
-  CreateBaseFrame(sender);
-  Push(result);
+  CreateBaseFrame(top);
+  SendCannotReturn(result);  // SAFEPOINT
 }
 
 
@@ -1130,6 +1361,9 @@ void Interpreter::Interpret() {
     ASSERT(fp_ != 0);
 
     uint8_t byte1 = *ip_++;
+    if (COUNT_EXECUTIONS) {
+      bytecode_counts_[byte1]++;
+    }
     switch (byte1) {
     case 0: case 1: case 2: case 3: case 4: case 5: case 6: case 7:
     case 8: case 9: case 10: case 11: case 12: case 13: case 14: case 15:
@@ -1192,6 +1426,11 @@ void Interpreter::Interpret() {
           break;
         }
       }
+      double raw_left, raw_right;
+      if (FloatOperands(left, right, &raw_left, &raw_right)) {
+        PopNAndPushFloat64(2, raw_left + raw_right);  // SAFEPOINT
+        break;
+      }
       CommonSend(byte1 - 80);
       break;
     }
@@ -1208,6 +1447,11 @@ void Interpreter::Interpret() {
           break;
         }
       }
+      double raw_left, raw_right;
+      if (FloatOperands(left, right, &raw_left, &raw_right)) {
+        PopNAndPushFloat64(2, raw_left - raw_right);  // SAFEPOINT
+        break;
+      }
       CommonSend(byte1 - 80);
       break;
     }
@@ -1224,6 +1468,11 @@ void Interpreter::Interpret() {
         }
         break;
       }
+      double raw_left, raw_right;
+      if (FloatOperands(left, right, &raw_left, &raw_right)) {
+        PopNAndPush(2, (raw_left < raw_right) ? true_ : false_);
+        break;
+      }
       CommonSend(byte1 - 80);
       break;
     }
@@ -1240,6 +1489,11 @@ void Interpreter::Interpret() {
         }
         break;
       }
+      double raw_left, raw_right;
+      if (FloatOperands(left, right, &raw_left, &raw_right)) {
+        PopNAndPush(2, (raw_left > raw_right) ? true_ : false_);
+        break;
+      }
       CommonSend(byte1 - 80);
       break;
     }
@@ -1256,6 +1510,11 @@ void Interpreter::Interpret() {
         }
         break;
       }
+      double raw_left, raw_right;
+      if (FloatOperands(left, right, &raw_left, &raw_right)) {
+        PopNAndPush(2, (raw_left <= raw_right) ? true_ : false_);
+        break;
+      }
       CommonSend(byte1 - 80);
       break;
     }
@@ -1272,6 +1531,11 @@ void Interpreter::Interpret() {
         }
         break;
       }
+      double raw_left, raw_right;
+      if (FloatOperands(left, right, &raw_left, &raw_right)) {
+        PopNAndPush(2, (raw_left >= raw_right) ? true_ : false_);
+        break;
+      }
       CommonSend(byte1 - 80);
       break;
     }
@@ -1288,6 +1552,11 @@ void Interpreter::Interpret() {
         }
         break;
       }
+      double raw_left, raw_right;
+      if (FloatOperands(left, right, &raw_left, &raw_right)) {
+        PopNAndPush(2, (raw_left == raw_right) ? true_ : false_);
+        break;
+      }
       CommonSend(byte1 - 80);
       break;
     }
@@ -1298,11 +1567,25 @@ void Interpreter::Interpret() {
     }
     case 88: {
       // *
+      Object* left = Stack(1);
+      Object* right = Stack(0);
+      double raw_left, raw_right;
+      if (FloatOperands(left, right, &raw_left, &raw_right)) {
+        PopNAndPushFloat64(2, raw_left * raw_right);  // SAFEPOINT
+        break;
+      }
       CommonSend(byte1 - 80);
       break;
     }
     case 89: {
       // /
+      Object* left = Stack(1);
+      Object* right = Stack(0);
+      double raw_left, raw_right;
+      if (FloatOperands(left, right, &raw_left, &raw_right)) {
+        PopNAndPushFloat64(2, raw_left / raw_right);  // SAFEPOINT
+        break;
+      }
       CommonSend(byte1 - 80);
       break;
     }
@@ -1759,19 +2042,116 @@ Activation* Interpreter::FlushAllFrames() {
     ip_ = FrameSavedIP(fp_);
     sp_ = FrameSavedSP(fp_);
     fp_ = saved_fp;
+    if (COUNT_EXECUTIONS) {
+      frames_flushed_++;
+    }
   }
 
   ip_ = 0;  // Was base sender.
   ASSERT(sp_ == stack_base_);
   ASSERT(fp_ == 0);
 #if defined(DEBUG)
-  memset(stack_limit_, kUninitializedByte, kStackSize);
+  memset(stack_limit_, kUninitializedByte, stack_slots_ * sizeof(Object*));
 #endif
+  if (COUNT_EXECUTIONS) {
+    flush_counts_[kFullFlush]++;
+  }
 
   return top;
 }
 
 
+// Moves the oldest frames to activations and slides the younger frames that
+// fit in a quarter of the stack down to the stack base, where the oldest of
+// them becomes the base frame. Unlike FlushAllFrames, the frames most likely
+// to return soon stay on the stack. Answers false if only the top frame would
+// be kept.
+bool Interpreter::FlushOldestFrames() {
+  Object** keep = fp_;
+  for (Object** fp = FrameSavedFP(fp_); fp != 0; fp = FrameSavedFP(fp)) {
+    Object** message_receiver = FrameSavedSP(fp) - 1;
+    if ((message_receiver - sp_) >= (stack_slots_ / 4)) {
+      break;
+    }
+    keep = fp;
+  }
+  if ((keep == fp_) || (FrameSavedFP(keep) == 0)) {
+    return false;
+  }
+
+  // Allocate first, while the frames are still consistent for GC.
+  for (Object** fp = FrameSavedFP(keep); fp != 0; fp = FrameSavedFP(fp)) {
+    EnsureActivation(fp);  // SAFEPOINT
+  }
+
+  // No more safepoints: move the state of the older frames into their
+  // activations as in FlushAllFrames.
+  const uint8_t* ip = FrameSavedIP(keep);
+  Object** sp = FrameSavedSP(keep);
+  Object** fp = FrameSavedFP(keep);
+  Activation* base_sender = FrameActivation(fp);
+  while (fp != 0) {
+    Object** saved_fp = FrameSavedFP(fp);
+    Activation* sender;
+    if (saved_fp != 0) {
+      sender = FrameActivation(saved_fp);
+    } else {
+      sender = FrameBaseSender(fp);
+    }
+    ASSERT((sender == nil) || sender->IsActivation());
+
+    Activation* activation = FrameActivation(fp);
+    activation->set_sender(sender);
+    activation->set_bci(activation->method()->BCI(ip));
+
+    intptr_t num_args = FlagsNumArgs(FrameFlags(fp));
+    intptr_t num_temps = num_args + FrameNumLocals(fp, sp);
+    for (intptr_t i = 0; i < num_temps; i++) {
+      activation->set_temp(i, FrameTemp(fp, i));
+    }
+    activation->set_stack_depth(SmallInteger::New(num_temps));
+
+    ip = FrameSavedIP(fp);
+    sp = FrameSavedSP(fp);
+    fp = saved_fp;
+    if (COUNT_EXECUTIONS) {
+      frames_flushed_++;
+    }
+  }
+  ASSERT(sp == stack_base_);
+
+  // Slide the kept frames so the oldest one's message receiver is at the
+  // base, and turn it into a base frame.
+  Object** message_receiver = FrameSavedSP(keep) - 1;
+  intptr_t delta = (stack_base_ - 1) - message_receiver;
+  keep[0] = 0;  // Saved FP.
+  keep[1] = base_sender;
+  memmove(sp_ + delta, sp_, (message_receiver - sp_ + 1) * sizeof(Object*));
+  sp_ += delta;
+  fp_ += delta;
+  for (Object** fp = fp_; fp != 0; fp = FrameSavedFP(fp)) {
+    Object** saved_fp = FrameSavedFP(fp);
+    if (saved_fp != 0) {
+      fp[0] = reinterpret_cast<SmallInteger*>(saved_fp + delta);
+    }
+    Activation* activation = FrameActivation(fp);
+    if (activation != 0) {
+      activation->set_sender(reinterpret_cast<Activation*>(fp), kNoBarrier);
+    }
+  }
+  ASSERT(FrameBaseSender(keep + delta) == base_sender);
+#if defined(DEBUG)
+  memset(stack_limit_, kUninitializedByte,
+         (sp_ - stack_limit_) * sizeof(Object*));
+#endif
+  if (COUNT_EXECUTIONS) {
+    flush_counts_[kPartialFlush]++;
+  }
+
+  return true;
+}
+
+
 bool Interpreter::HasLivingFrame(Activation* activation) {
   if (!activation->sender()->IsSmallInteger()) {
     return false;
@@ -1796,6 +2176,51 @@ bool Interpreter::HasLivingFrame(Activation* activation) {
 }
 
 
+static bool IsMarkedMethod(Method* method) {
+  intptr_t prim = method->Primitive();
+  return Primitives::IsUnwindProtect(prim) ||
+      Primitives::IsExceptionHandler(prim) ||
+      Primitives::IsSimulationRoot(prim);
+}
+
+
+// Answers the nearest sender of activation whose method is marked as an
+// unwind-protect, exception handler or simulation root, stopping before limit.
+// Only the answer is given an activation; living frames in between are walked
+// in place instead of being reified one sender at a time.
+Object* Interpreter::ActivationNextMarkedSender(Activation* activation,
+                                                Object* limit) {
+  for (;;) {
+    Object* sender;
+    if (HasLivingFrame(activation)) {
+      Object** fp = reinterpret_cast<Object**>(activation->sender());
+      Object** sender_fp = FrameSavedFP(fp);
+      while (sender_fp != 0) {
+        fp = sender_fp;
+        if (FrameActivation(fp) == limit) {
+          return nil;
+        }
+        if (IsMarkedMethod(FrameMethod(fp))) {
+          return EnsureActivation(fp);  // SAFEPOINT
+        }
+        sender_fp = FrameSavedFP(fp);
+      }
+      sender = FrameBaseSender(fp);
+    } else {
+      sender = activation->sender();
+    }
+
+    if (!sender->IsActivation() || (sender == limit)) {
+      return nil;
+    }
+    activation = static_cast<Activation*>(sender);
+    if ((activation->method() != nil) && IsMarkedMethod(activation->method())) {
+      return activation;
+    }
+  }
+}
+
+
 Activation* Interpreter::CurrentActivation() {
   return EnsureActivation(fp_);  // SAFEPOINT
 }
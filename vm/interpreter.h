@@ -12,6 +12,7 @@
 #include "vm/flags.h"
 #include "vm/lookup_cache.h"
 #include "vm/object.h"
+#include "vm/primitives.h"
 
 namespace psoup {
 
@@ -19,6 +20,22 @@ class Heap;
 class Isolate;
 class Object;
 
+enum SendKind {
+  kOrdinarySend,
+  kSuperSend,
+  kImplicitReceiverSend,
+  kOuterSend,
+  kSelfSend,
+  kLexicalSend,
+  kNumSendKinds,
+};
+
+enum FlushKind {
+  kFullFlush,
+  kPartialFlush,
+  kNumFlushKinds,
+};
+
 class Interpreter {
  public:
   Interpreter(Heap* heap, Isolate* isolate);
@@ -26,17 +43,42 @@ class Interpreter {
 
   Isolate* isolate() const { return isolate_; }
 
+  // Sets the size of the stacks of interpreters created afterwards.
+  static void SetStackSize(intptr_t size);
+
   void Enter();
   void Exit();
   void Perform(String* selector, intptr_t num_args);
   Method* MethodAt(Behavior* cls, String* selector);
   void ActivateClosure(intptr_t num_args);
 
-  void Interrupt() { checked_stack_limit_ = reinterpret_cast<Object**>(-1); }
+  // May be called from another thread.
+  void Interrupt() {
+    interrupted_ = true;
+    checked_stack_limit_ = reinterpret_cast<Object**>(-1);
+  }
+  // Makes the next send answer the result of sending #outOfMemory to the
+  // sender's activation instead.
+  void OutOfMemory() {
+    out_of_memory_ = true;
+    checked_stack_limit_ = reinterpret_cast<Object**>(-1);
+  }
   void PrintStack();
 
   const uint8_t* IPForAssert() { return ip_; }
 
+  // Only maintained when COUNT_EXECUTIONS is set. Laid out as the bytecode
+  // counts, the primitive counts, the lookup cache hits and misses for each
+  // SendKind, the number of flushes of each FlushKind, then the number of
+  // frames moved to activations by those flushes.
+  static constexpr intptr_t kNumBytecodes = 256;
+  static constexpr intptr_t kNumExecutionCounters =
+      kNumBytecodes + Primitives::kNumPrimitives + 2 * kNumSendKinds +
+      kNumFlushKinds + 1;
+  void CountPrimitive(intptr_t prim) { primitive_counts_[prim]++; }
+  int64_t ExecutionCounterAt(intptr_t index) const;
+  void PrintExecutionCounters();
+
   Activation* CurrentActivation();
   void SetCurrentActivation(Activation* new_activation);
   Object* ActivationSender(Activation* activation);
@@ -51,6 +93,7 @@ class Interpreter {
                            Object* value);
   intptr_t ActivationTempSize(Activation* activation);
   void ActivationTempSizePut(Activation* activation, intptr_t new_size);
+  Object* ActivationNextMarkedSender(Activation* activation, Object* limit);
 
   void GCPrologue();
   void RootPointers(Object*** from, Object*** to) {
@@ -122,6 +165,7 @@ class Interpreter {
   INLINE void PushEnclosingObject(intptr_t depth);
   INLINE void PushNewArrayWithElements(intptr_t size);
   INLINE void PushNewArray(intptr_t size);
+  INLINE void PopNAndPushFloat64(intptr_t n, double value);
   void PushClosure(intptr_t num_copied, intptr_t num_args, intptr_t block_size);
 
   INLINE void CommonSend(intptr_t offset);
@@ -162,6 +206,7 @@ class Interpreter {
   NOINLINE void SendCannotReturn(Object* result);
   NOINLINE void SendAboutToReturnThrough(Object* result, Activation* unwind);
   NOINLINE void SendNonBooleanReceiver(Object* non_boolean);
+  NOINLINE void SendOutOfMemory();
 
   INLINE void InsertAbsentReceiver(Object* receiver, intptr_t num_args);
   INLINE void ActivateAbsent(Method* method, Object* receiver,
@@ -177,17 +222,31 @@ class Interpreter {
   NOINLINE void CreateBaseFrame(Activation* activation);
   NOINLINE Activation* EnsureActivation(Object** fp);
   NOINLINE Activation* FlushAllFrames();
+  NOINLINE bool FlushOldestFrames();
   bool HasLivingFrame(Activation* activation);
 
-  static constexpr intptr_t kStackSlots = 1024;
-  static constexpr intptr_t kStackSize = kStackSlots * sizeof(Object*);
+  void CountSend(SendKind kind, bool hit) {
+    if (hit) {
+      send_hits_[kind]++;
+    } else {
+      send_misses_[kind]++;
+    }
+  }
+
+  static constexpr intptr_t kDefaultStackSlots = 1024;
+  static constexpr intptr_t kMinStackSlots = 256;
+  static intptr_t configured_stack_slots_;
+  const intptr_t stack_slots_;
 
   const uint8_t* ip_;
   Object** sp_;
   Object** fp_;
   Object** stack_base_;
   Object** stack_limit_;
+  // Set to -1 to make the next send check for an interrupt or out of memory.
   Object** volatile checked_stack_limit_;
+  volatile bool interrupted_;
+  bool out_of_memory_;
 
   Object* nil_;
   Object* false_;
@@ -198,6 +257,13 @@ class Interpreter {
   Isolate* const isolate_;
   jmp_buf* environment_;
   LookupCache lookup_cache_;
+
+  int64_t bytecode_counts_[kNumBytecodes];
+  int64_t primitive_counts_[Primitives::kNumPrimitives];
+  int64_t send_hits_[kNumSendKinds];
+  int64_t send_misses_[kNumSendKinds];
+  int64_t flush_counts_[kNumFlushKinds];
+  int64_t frames_flushed_;
 };
 
 }  // namespace psoup
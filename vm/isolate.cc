@@ -12,9 +12,25 @@
 #include "vm/snapshot.h"
 #include "vm/thread.h"
 #include "vm/thread_pool.h"
+#include "vm/virtual_memory.h"
 
 namespace psoup {
 
+struct Isolate::Mapping {
+  VirtualMemory memory;
+  bool in_use;
+};
+
+
+// A heap deserialized from a snapshot and never run, for Heap::CloneFrom.
+struct Isolate::Template {
+  void* snapshot;
+  Heap* heap;
+  Interpreter* interpreter;
+  Template* next;
+};
+
+
 #if defined(OS_EMSCRIPTEN)
 Isolate* Isolate::current_ = NULL;
 #else
@@ -23,10 +39,21 @@ thread_local Isolate* Isolate::current_ = NULL;
 Monitor* Isolate::isolates_list_monitor_ = NULL;
 Isolate* Isolate::isolates_list_head_ = NULL;
 ThreadPool* Isolate::thread_pool_ = NULL;
+bool Isolate::numa_local_ = false;
+Mutex* Isolate::templates_mutex_ = NULL;
+Isolate::Template* Isolate::templates_ = NULL;
+bool Isolate::clone_template_ = false;
+intptr_t Isolate::pool_size_ = 0;
+Isolate* Isolate::idle_isolates_ = NULL;
+intptr_t Isolate::idle_count_ = 0;
+intptr_t Isolate::filling_count_ = 0;
+intptr_t Isolate::pool_hits_ = 0;
+intptr_t Isolate::pool_misses_ = 0;
 
 
 void Isolate::Startup() {
   isolates_list_monitor_ = new Monitor();
+  templates_mutex_ = new Mutex();
   thread_pool_ = new ThreadPool();
 }
 
@@ -34,12 +61,67 @@ void Isolate::Startup() {
 void Isolate::Shutdown() {
   delete thread_pool_;  // Waits for all tasks to complete.
   thread_pool_ = NULL;
+  while (idle_isolates_ != NULL) {
+    Isolate* isolate = idle_isolates_;
+    idle_isolates_ = isolate->next_;
+    isolate->next_ = NULL;
+    isolate->Unpark();
+    delete isolate;
+  }
+  idle_count_ = 0;
   ASSERT(isolates_list_head_ == NULL);
+  while (templates_ != NULL) {
+    Template* t = templates_;
+    templates_ = t->next;
+    delete t->interpreter;
+    delete t->heap;
+    delete t;
+  }
+  delete templates_mutex_;
+  templates_mutex_ = NULL;
   delete isolates_list_monitor_;
   isolates_list_monitor_ = NULL;
 }
 
 
+void Isolate::SetSpawnPolicy(intptr_t pool_size, bool clone_template) {
+  pool_size_ = pool_size;
+  clone_template_ = clone_template;
+}
+
+
+void Isolate::PoolStatistics(intptr_t* hits, intptr_t* misses,
+                             intptr_t* idle, intptr_t* filling) {
+  MonitorLocker ml(isolates_list_monitor_);
+  *hits = pool_hits_;
+  *misses = pool_misses_;
+  *idle = idle_count_;
+  *filling = filling_count_;
+}
+
+
+Isolate::Template* Isolate::FindTemplate(void* snapshot,
+                                         size_t snapshot_length) {
+  MutexLocker ml(templates_mutex_);
+  for (Template* t = templates_; t != NULL; t = t->next) {
+    if (t->snapshot == snapshot) {
+      return t;
+    }
+  }
+  Template* t = new Template();
+  t->snapshot = snapshot;
+  t->heap = new Heap();
+  t->interpreter = new Interpreter(t->heap, NULL);
+  {
+    Deserializer deserializer(t->heap, snapshot, snapshot_length);
+    deserializer.Deserialize();
+  }
+  t->next = templates_;
+  templates_ = t;
+  return t;
+}
+
+
 void Isolate::AddIsolateToList(Isolate* isolate) {
   MonitorLocker ml(isolates_list_monitor_);
   ASSERT(isolate != NULL);
@@ -104,11 +186,20 @@ Isolate::Isolate(void* snapshot, size_t snapshot_length, uint64_t seed) :
     snapshot_length_(snapshot_length),
     salt_(static_cast<uintptr_t>(seed)),
     random_(seed),
+    mappings_(NULL),
+    mappings_capacity_(0),
+    numa_bound_(false),
     next_(NULL) {
+  if (numa_local_) {
+    // Before the heap is touched, so its pages are faulted in on this node.
+    numa_bound_ = Thread::BindToCurrentNumaNode();
+  }
   heap_ = new Heap();
   interpreter_ = new Interpreter(heap_, this);
-  loop_ = new PlatformMessageLoop(this);
-  {
+  loop_ = MessageLoop::New(this);
+  if (clone_template_) {
+    heap_->CloneFrom(FindTemplate(snapshot, snapshot_length)->heap);
+  } else {
     Deserializer deserializer(heap_, snapshot, snapshot_length);
     deserializer.Deserialize();
   }
@@ -125,54 +216,147 @@ Isolate::~Isolate() {
   current_ = NULL;
 
   RemoveIsolateFromList(this);
+  delete interpreter_;  // May report on the heap.
   delete heap_;
-  delete interpreter_;
   delete loop_;
+  for (intptr_t i = 0; i < mappings_capacity_; i++) {
+    if (mappings_[i].in_use) {
+      mappings_[i].memory.Unmap();
+    }
+  }
+  free(mappings_);
+  if (numa_bound_) {
+    Thread::UnbindFromNumaNode();
+  }
 }
 
 
-void Isolate::ActivateMessage(IsolateMessage* isolate_message) {
-  Object* message;
+intptr_t Isolate::MapFile(const char* filename) {
+  VirtualMemory memory;
+  if (!VirtualMemory::TryMapReadOnly(filename, &memory)) {
+    return -1;
+  }
+  intptr_t handle = 0;
+  while ((handle < mappings_capacity_) && mappings_[handle].in_use) {
+    handle++;
+  }
+  if (handle == mappings_capacity_) {
+    intptr_t capacity = mappings_capacity_ == 0 ? 4 : 2 * mappings_capacity_;
+    mappings_ = reinterpret_cast<Mapping*>(
+        realloc(mappings_, capacity * sizeof(Mapping)));
+    if (mappings_ == NULL) {
+      FATAL("Out of memory");
+    }
+    for (intptr_t i = mappings_capacity_; i < capacity; i++) {
+      mappings_[i].in_use = false;
+    }
+    mappings_capacity_ = capacity;
+  }
+  mappings_[handle].memory = memory;
+  mappings_[handle].in_use = true;
+  return handle;
+}
+
+
+bool Isolate::LookupMappedFile(intptr_t handle,
+                               const uint8_t** base,
+                               intptr_t* size) {
+  if ((handle < 0) || (handle >= mappings_capacity_) ||
+      !mappings_[handle].in_use) {
+    return false;
+  }
+  *base = reinterpret_cast<const uint8_t*>(mappings_[handle].memory.base());
+  *size = mappings_[handle].memory.size();
+  return true;
+}
+
+
+bool Isolate::UnmapFile(intptr_t handle) {
+  if ((handle < 0) || (handle >= mappings_capacity_) ||
+      !mappings_[handle].in_use) {
+    return false;
+  }
+  mappings_[handle].memory.Unmap();
+  mappings_[handle].in_use = false;
+  return true;
+}
+
+
+Object* Isolate::NewMessageObject(IsolateMessage* isolate_message) {
   if (isolate_message->data() != NULL) {
     intptr_t length = isolate_message->length();
     ByteArray* bytes = heap_->AllocateByteArray(length);  // SAFEPOINT
     memcpy(bytes->element_addr(0), isolate_message->data(), length);
-    message = bytes;
-  } else {
-    int argc = isolate_message->argc();
-    Array* strings = heap_->AllocateArray(argc);  // SAFEPOINT
-    for (intptr_t i = 0; i < argc; i++) {
-      strings->set_element(i, SmallInteger::New(0));
-    }
+    return bytes;
+  }
 
-    HandleScope h1(heap_, reinterpret_cast<Object**>(&strings));
-    for (intptr_t i = 0; i < argc; i++) {
-      const char* cstr = isolate_message->argv()[i];
-      intptr_t length = strlen(cstr);
-      String* string = heap_->AllocateString(length);  // SAFEPOINT
-      memcpy(string->element_addr(0), cstr, length);
-      strings->set_element(i, string);
-    }
-    message = strings;
+  int argc = isolate_message->argc();
+  Array* strings = heap_->AllocateArray(argc);  // SAFEPOINT
+  for (intptr_t i = 0; i < argc; i++) {
+    strings->set_element(i, SmallInteger::New(0));
+  }
+
+  HandleScope h1(heap_, reinterpret_cast<Object**>(&strings));
+  for (intptr_t i = 0; i < argc; i++) {
+    const char* cstr = isolate_message->argv()[i];
+    intptr_t length = strlen(cstr);
+    String* string = heap_->AllocateString(length);  // SAFEPOINT
+    memcpy(string->element_addr(0), cstr, length);
+    strings->set_element(i, string);
   }
+  return strings;
+}
+
 
-  Port port_id = isolate_message->dest_port();
-  Object* port;
+Object* Isolate::NewPortObject(Port port_id) {
   if (port_id == ILLEGAL_PORT) {
-    port = interpreter_->nil_obj();
-  } else if (SmallInteger::IsSmiValue(port_id)) {
-    port = SmallInteger::New(port_id);
-  } else {
-    HandleScope h1(heap_, reinterpret_cast<Object**>(&message));
-    MediumInteger* mint = heap_->AllocateMediumInteger();  // SAFEPOINT
-    mint->set_value(port_id);
-    port = mint;
+    return interpreter_->nil_obj();
+  }
+  if (SmallInteger::IsSmiValue(port_id)) {
+    return SmallInteger::New(port_id);
   }
+  MediumInteger* mint = heap_->AllocateMediumInteger();  // SAFEPOINT
+  mint->set_value(port_id);
+  return mint;
+}
+
 
+void Isolate::ActivateMessage(IsolateMessage* isolate_message) {
+  Object* message = NewMessageObject(isolate_message);  // SAFEPOINT
+  HandleScope h1(heap_, &message);
+  Object* port = NewPortObject(isolate_message->dest_port());  // SAFEPOINT
   Activate(message, port);
 }
 
 
+// Delivers a list of messages in one activation, as an array of messages and
+// a parallel array of their ports.
+void Isolate::ActivateMessages(IsolateMessage* isolate_messages,
+                               intptr_t count) {
+  Array* messages = heap_->AllocateArray(count);  // SAFEPOINT
+  for (intptr_t i = 0; i < count; i++) {
+    messages->set_element(i, SmallInteger::New(0));
+  }
+  HandleScope h1(heap_, reinterpret_cast<Object**>(&messages));
+  Array* ports = heap_->AllocateArray(count);  // SAFEPOINT
+  for (intptr_t i = 0; i < count; i++) {
+    ports->set_element(i, SmallInteger::New(0));
+  }
+  HandleScope h2(heap_, reinterpret_cast<Object**>(&ports));
+
+  IsolateMessage* isolate_message = isolate_messages;
+  for (intptr_t i = 0; i < count; i++) {
+    Object* element = NewMessageObject(isolate_message);  // SAFEPOINT
+    messages->set_element(i, element);
+    element = NewPortObject(isolate_message->dest_port());  // SAFEPOINT
+    ports->set_element(i, element);
+    isolate_message = isolate_message->next_;
+  }
+
+  Activate(messages, ports);
+}
+
+
 void Isolate::ActivateWakeup() {
   Object* nil = interpreter_->nil_obj();
   Activate(nil, nil);
@@ -257,6 +441,116 @@ void Isolate::Interpret() {
 }
 
 
+// Taken out of service while idle in the pool: not current on any thread and
+// not reachable by InterruptAll.
+void Isolate::Park() {
+  ASSERT(current_ == this);
+  current_ = NULL;
+  RemoveIsolateFromList(this);
+  next_ = NULL;
+  if (numa_bound_) {
+    Thread::UnbindFromNumaNode();
+    numa_bound_ = false;
+  }
+}
+
+
+void Isolate::Unpark() {
+  ASSERT(current_ == NULL);
+  current_ = this;
+  AddIsolateToList(this);
+}
+
+
+void Isolate::AddToPool() {
+  Park();
+  MonitorLocker ml(isolates_list_monitor_);
+  next_ = idle_isolates_;
+  idle_isolates_ = this;
+  idle_count_++;
+  filling_count_--;
+}
+
+
+Isolate* Isolate::TakeIdle(void* snapshot, size_t snapshot_length) {
+  if (pool_size_ == 0) {
+    return NULL;
+  }
+  Isolate* result = NULL;
+  {
+    MonitorLocker ml(isolates_list_monitor_);
+    Isolate* previous = NULL;
+    for (Isolate* isolate = idle_isolates_; isolate != NULL;
+         isolate = isolate->next_) {
+      if (isolate->snapshot_ == snapshot) {
+        if (previous == NULL) {
+          idle_isolates_ = isolate->next_;
+        } else {
+          previous->next_ = isolate->next_;
+        }
+        isolate->next_ = NULL;
+        idle_count_--;
+        result = isolate;
+        break;
+      }
+      previous = isolate;
+    }
+    if (result == NULL) {
+      pool_misses_++;
+    } else {
+      pool_hits_++;
+    }
+  }
+  FillPool(snapshot, snapshot_length);
+  if (result != NULL) {
+    result->Unpark();
+  }
+  return result;
+}
+
+
+class FillPoolTask : public ThreadPool::Task {
+ public:
+  FillPoolTask(void* snapshot, size_t snapshot_length) :
+    snapshot_(snapshot),
+    snapshot_length_(snapshot_length) {
+  }
+
+  virtual void Run() {
+    uint64_t seed = OS::CurrentMonotonicNanos();
+    Isolate* isolate = new Isolate(snapshot_, snapshot_length_, seed);
+    isolate->AddToPool();
+  }
+
+ private:
+  void* snapshot_;
+  size_t snapshot_length_;
+
+  DISALLOW_COPY_AND_ASSIGN(FillPoolTask);
+};
+
+
+void Isolate::FillPool(void* snapshot, size_t snapshot_length) {
+  intptr_t needed;
+  {
+    MonitorLocker ml(isolates_list_monitor_);
+    needed = pool_size_ - idle_count_ - filling_count_;
+    if (needed <= 0) {
+      return;
+    }
+    filling_count_ += needed;
+  }
+  for (intptr_t i = 0; i < needed; i++) {
+    FillPoolTask* task = new FillPoolTask(snapshot, snapshot_length);
+    if (!thread_pool_->Run(task)) {
+      delete task;
+      MonitorLocker ml(isolates_list_monitor_);
+      filling_count_--;
+    }
+  }
+}
+
+
 class SpawnIsolateTask : public ThreadPool::Task {
  public:
   SpawnIsolateTask(void* snapshot,
@@ -268,8 +562,11 @@ class SpawnIsolateTask : public ThreadPool::Task {
   }
 
   virtual void Run() {
-    uint64_t seed = OS::CurrentMonotonicNanos();
-    Isolate* child_isolate = new Isolate(snapshot_, snapshot_length_, seed);
+    Isolate* child_isolate = Isolate::TakeIdle(snapshot_, snapshot_length_);
+    if (child_isolate == NULL) {
+      uint64_t seed = OS::CurrentMonotonicNanos();
+      child_isolate = new Isolate(snapshot_, snapshot_length_, seed);
+    }
     child_isolate->loop()->PostMessage(initial_message_);
     initial_message_ = NULL;
     intptr_t exit_code = child_isolate->loop()->Run();
@@ -16,6 +16,7 @@ class Heap;
 class Interpreter;
 class MessageLoop;
 class Monitor;
+class Mutex;
 class Object;
 class ThreadPool;
 
@@ -30,6 +31,7 @@ class Isolate {
   Random& random() { return random_; }
 
   void ActivateMessage(IsolateMessage* message);
+  void ActivateMessages(IsolateMessage* messages, intptr_t count);
   void ActivateWakeup();
   void ActivateSignal(intptr_t handle,
                       intptr_t status,
@@ -44,11 +46,47 @@ class Isolate {
   static void Startup();
   static void Shutdown();
 
+  // When enabled, each isolate keeps the thread running it on the NUMA node
+  // where it was created, so its heap is allocated on and used from the same
+  // node. Set before any isolate starts.
+  static void SetNumaLocal(bool enabled) { numa_local_ = enabled; }
+
+  // Spawns take one of up to pool_size idle isolates made ahead of time, when
+  // one made from the same snapshot is available. With clone_template,
+  // isolates are made by copying a heap deserialized once per snapshot rather
+  // than deserializing every time. Set before any isolate starts.
+  static void SetSpawnPolicy(intptr_t pool_size, bool clone_template);
+  // Starts making idle isolates from snapshot until the pool is full.
+  static void FillPool(void* snapshot, size_t snapshot_length);
+  // Number of spawns that did and did not find an idle isolate, and of
+  // isolates now idle in the pool and still being made for it.
+  static void PoolStatistics(intptr_t* hits, intptr_t* misses,
+                             intptr_t* idle, intptr_t* filling);
+
   static void InterruptAll();
   void Interrupt();
   void PrintStack();
 
+  // Files mapped read-only on behalf of the program. A handle indexes this
+  // isolate's table, so a handle that outlives its mapping is rejected rather
+  // than reaching unmapped memory. Mappings still open when the isolate is
+  // destroyed are released with it.
+  intptr_t MapFile(const char* filename);
+  bool LookupMappedFile(intptr_t handle, const uint8_t** base, intptr_t* size);
+  bool UnmapFile(intptr_t handle);
+
  private:
+  struct Mapping;
+  struct Template;
+
+  static Template* FindTemplate(void* snapshot, size_t snapshot_length);
+  static Isolate* TakeIdle(void* snapshot, size_t snapshot_length);
+  void AddToPool();
+  void Park();
+  void Unpark();
+
+  Object* NewMessageObject(IsolateMessage* message);
+  Object* NewPortObject(Port port);
   void Activate(Object* message, Object* port);
 
   Heap* heap_;
@@ -58,6 +96,9 @@ class Isolate {
   size_t snapshot_length_;
   uintptr_t salt_;
   Random random_;
+  Mapping* mappings_;
+  intptr_t mappings_capacity_;
+  bool numa_bound_;
   Isolate* next_;
 
   void AddIsolateToList(Isolate* isolate);
@@ -71,6 +112,20 @@ class Isolate {
   static Monitor* isolates_list_monitor_;
   static Isolate* isolates_list_head_;
   static ThreadPool* thread_pool_;
+  static bool numa_local_;
+  static Mutex* templates_mutex_;
+  static Template* templates_;
+  static bool clone_template_;
+  // Guarded by isolates_list_monitor_. Idle isolates are chained by next_.
+  static intptr_t pool_size_;
+  static Isolate* idle_isolates_;
+  static intptr_t idle_count_;
+  static intptr_t filling_count_;
+  static intptr_t pool_hits_;
+  static intptr_t pool_misses_;
+
+  friend class SpawnIsolateTask;
+  friend class FillPoolTask;
 
   DISALLOW_COPY_AND_ASSIGN(Isolate);
 };
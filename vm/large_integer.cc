@@ -30,8 +30,6 @@ LargeInteger* LargeInteger::Expand(Object* integer, Heap* H) {
     value = 0;
   }
 
-  LargeInteger* result = H->AllocateLargeInteger(kMintDigits);
-  result->set_negative(value < 0);
   uint64_t absolute_value;
   if (value < 0) {
     absolute_value = -static_cast<uint64_t>(value);
@@ -39,10 +37,20 @@ LargeInteger* LargeInteger::Expand(Object* integer, Heap* H) {
     absolute_value = static_cast<uint64_t>(value);
   }
 
+  LargeInteger* result = FromUint64(absolute_value, H);
+  result->set_negative(value < 0);
+  return result;
+}
+
+
+LargeInteger* LargeInteger::FromUint64(uint64_t value, Heap* H) {
+  LargeInteger* result = H->AllocateLargeInteger(kMintDigits);
+  result->set_negative(false);
+
   intptr_t i = 0;
-  while (absolute_value != 0) {
-    result->set_digit(i, absolute_value & kDigitMask);
-    absolute_value = absolute_value >> kDigitShift;
+  while (value != 0) {
+    result->set_digit(i, value & kDigitMask);
+    value = value >> kDigitShift;
     i++;
   }
   result->set_size(i);
@@ -55,6 +63,21 @@ LargeInteger* LargeInteger::Expand(Object* integer, Heap* H) {
 }
 
 
+bool LargeInteger::ToUint64(LargeInteger* large, uint64_t* value) {
+  if (large->negative() || (large->size() > kMintDigits)) {
+    return false;
+  }
+
+  uint64_t result = 0;
+  for (intptr_t i = large->size() - 1; i >= 0; i--) {
+    result <<= kDigitShift;
+    result |= large->digit(i);
+  }
+  *value = result;
+  return true;
+}
+
+
 Object* LargeInteger::Reduce(LargeInteger* large, Heap* H) {
   if (large->size() > kMintDigits) {
     return large;
@@ -19,8 +19,62 @@ static void SIGINT_handler(int sig) {
 }
 
 int main(int argc, const char** argv) {
-  if (argc < 2) {
-    psoup::OS::PrintErr("Usage: %s <program.vfuel>\n", argv[0]);
+  const char* program = argv[0];
+  intptr_t stack_size = 0;
+  intptr_t heap_soft_limit = 0;
+  intptr_t heap_hard_limit = 0;
+  intptr_t pause_goal = 0;
+  intptr_t tenure_age = 0;
+  intptr_t page_pool = -1;
+  intptr_t isolate_pool = 0;
+  bool clone_template = false;
+  bool huge_pages = false;
+  bool numa_local = false;
+  const char* message_loop = NULL;
+  bool bad_option = false;
+  while ((argc >= 2) && (strncmp(argv[1], "--", 2) == 0)) {
+    if (strncmp(argv[1], "--stack-size=", 13) == 0) {
+      stack_size = strtol(argv[1] + 13, NULL, 10) * KB;
+    } else if (strncmp(argv[1], "--heap-soft-limit=", 18) == 0) {
+      heap_soft_limit = strtol(argv[1] + 18, NULL, 10) * MB;
+    } else if (strncmp(argv[1], "--heap-hard-limit=", 18) == 0) {
+      heap_hard_limit = strtol(argv[1] + 18, NULL, 10) * MB;
+    } else if (strncmp(argv[1], "--scavenge-pause-goal=", 22) == 0) {
+      pause_goal = strtol(argv[1] + 22, NULL, 10);
+    } else if (strncmp(argv[1], "--tenure-age=", 13) == 0) {
+      tenure_age = strtol(argv[1] + 13, NULL, 10);
+    } else if (strncmp(argv[1], "--page-pool=", 12) == 0) {
+      page_pool = strtol(argv[1] + 12, NULL, 10) * MB;
+    } else if (strncmp(argv[1], "--isolate-pool=", 15) == 0) {
+      isolate_pool = strtol(argv[1] + 15, NULL, 10);
+    } else if (strcmp(argv[1], "--clone-template") == 0) {
+      clone_template = true;
+    } else if (strcmp(argv[1], "--huge-pages") == 0) {
+      huge_pages = true;
+    } else if (strcmp(argv[1], "--numa-local") == 0) {
+      numa_local = true;
+    } else if (strncmp(argv[1], "--message-loop=", 15) == 0) {
+      message_loop = argv[1] + 15;
+    } else {
+      bad_option = true;
+    }
+    argc--;
+    argv++;
+  }
+  if ((argc < 2) || (stack_size < 0) || (heap_soft_limit < 0) ||
+      (heap_hard_limit < 0) || (pause_goal < 0) || (tenure_age < 0) ||
+      (page_pool < -1) || (isolate_pool < 0) || bad_option) {
+    psoup::OS::PrintErr("Usage: %s [--stack-size=<kB>] "
+                        "[--heap-soft-limit=<MB>] [--heap-hard-limit=<MB>] "
+                        "[--scavenge-pause-goal=<us>] [--tenure-age=<n>] "
+                        "[--page-pool=<MB>] [--isolate-pool=<n>] "
+                        "[--clone-template] [--huge-pages] [--numa-local] "
+                        "[--message-loop=epoll|io_uring] <program.vfuel>\n",
+                        program);
+    return -1;
+  }
+  if ((message_loop != NULL) && !PrimordialSoup_SetMessageLoop(message_loop)) {
+    psoup::OS::PrintErr("Message loop '%s' is not available\n", message_loop);
     return -1;
   }
 
@@ -30,6 +84,16 @@ int main(int argc, const char** argv) {
 
   psoup::VirtualMemory snapshot = psoup::VirtualMemory::MapReadOnly(argv[1]);
   PrimordialSoup_Startup();
+  if (stack_size != 0) {
+    PrimordialSoup_SetStackSize(stack_size);
+  }
+  PrimordialSoup_SetHeapLimits(heap_soft_limit, heap_hard_limit);
+  PrimordialSoup_SetScavengePolicy(pause_goal, tenure_age);
+  PrimordialSoup_SetHeapPlacement(huge_pages, numa_local);
+  if (page_pool >= 0) {
+    PrimordialSoup_SetPagePool(page_pool);
+  }
+  PrimordialSoup_SetIsolatePool(isolate_pool, clone_template);
   void (*defaultSIGINT)(int) = signal(SIGINT, SIGINT_handler);
 
   intptr_t exit_code =
@@ -39,11 +103,7 @@ int main(int argc, const char** argv) {
   signal(SIGINT, defaultSIGINT);
   PrimordialSoup_Shutdown();
 
-  // TODO(rmacnak): File and anonymous mappings are freed differently on
-  // Windows.
-#if !defined(OS_WINDOWS)
-  snapshot.Free();
-#endif
+  snapshot.Unmap();
 
   return exit_code;
 }
@@ -4,6 +4,8 @@
 
 #include "vm/message_loop.h"
 
+#include <string.h>
+
 #include "vm/isolate.h"
 #include "vm/os.h"
 
@@ -14,6 +16,58 @@ MessageLoop::MessageLoop(Isolate* isolate)
 
 MessageLoop::~MessageLoop() {}
 
+#if defined(OS_LINUX)
+static bool use_io_uring = false;
+#endif
+
+bool MessageLoop::SetImplementation(const char* name) {
+#if defined(OS_LINUX)
+  if (strcmp(name, "epoll") == 0) {
+    use_io_uring = false;
+    return true;
+  }
+  if (strcmp(name, "io_uring") == 0) {
+    use_io_uring = IOUringMessageLoop::IsSupported();
+    return use_io_uring;
+  }
+#endif
+  return false;
+}
+
+MessageLoop* MessageLoop::New(Isolate* isolate) {
+#if defined(OS_LINUX)
+  if (use_io_uring) {
+    return new IOUringMessageLoop(isolate);
+  }
+#endif
+  return new PlatformMessageLoop(isolate);
+}
+
+bool MessageLoop::StartTransfers(intptr_t handle) {
+  return false;
+}
+
+bool MessageLoop::IsTransferring(intptr_t handle) {
+  return false;
+}
+
+intptr_t MessageLoop::CloseTransfers(intptr_t handle) {
+  UNREACHABLE();
+  return 0;
+}
+
+intptr_t MessageLoop::Read(intptr_t handle, uint8_t* data, intptr_t length) {
+  UNREACHABLE();
+  return 0;
+}
+
+intptr_t MessageLoop::Write(intptr_t handle,
+                            const uint8_t* data,
+                            intptr_t length) {
+  UNREACHABLE();
+  return 0;
+}
+
 void MessageLoop::DispatchMessage(IsolateMessage* message) {
   if (isolate_ == NULL) {
     delete message;
@@ -25,6 +79,32 @@ void MessageLoop::DispatchMessage(IsolateMessage* message) {
   isolate_->Interpret();
 }
 
+void MessageLoop::DispatchMessages(IsolateMessage* messages) {
+  if ((messages == NULL) || (messages->next_ == NULL)) {
+    if (messages != NULL) {
+      DispatchMessage(messages);
+    }
+    return;
+  }
+
+  intptr_t count = 0;
+  for (IsolateMessage* message = messages; message != NULL;
+       message = message->next_) {
+    count++;
+  }
+  if (isolate_ != NULL) {
+    isolate_->ActivateMessages(messages, count);
+  }
+  while (messages != NULL) {
+    IsolateMessage* next = messages->next_;
+    delete messages;
+    messages = next;
+  }
+  if (isolate_ != NULL) {
+    isolate_->Interpret();
+  }
+}
+
 void MessageLoop::DispatchWakeup() {
   if (isolate_ == NULL) {
     return;
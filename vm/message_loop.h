@@ -6,6 +6,7 @@
 #define VM_MESSAGE_LOOP_H_
 
 #include "vm/port.h"
+#include "vm/timer_wheel.h"
 
 namespace psoup {
 
@@ -36,6 +37,8 @@ class IsolateMessage {
   friend class EmscriptenMessageLoop;
   friend class FuchsiaMessageLoop;
   friend class IOCPMessageLoop;
+  friend class IOUringMessageLoop;
+  friend class Isolate;
   friend class KQueueMessageLoop;
 
   IsolateMessage* next_;
@@ -60,6 +63,11 @@ class MessageLoop {
   explicit MessageLoop(Isolate* isolate);
   virtual ~MessageLoop();
 
+  // Chooses the implementation used by isolates created afterwards. Answers
+  // false if the named implementation is not available.
+  static bool SetImplementation(const char* name);
+  static MessageLoop* New(Isolate* isolate);
+
   virtual void PostMessage(IsolateMessage* message) = 0;
   virtual intptr_t AwaitSignal(intptr_t handle, intptr_t signals) = 0;
   virtual void CancelSignalWait(intptr_t wait_id) = 0;
@@ -69,11 +77,33 @@ class MessageLoop {
   virtual intptr_t Run() = 0;
   virtual void Interrupt() = 0;
 
+  // Completion-based transfers for a connected socket, for loops that read
+  // into and write from buffers of their own. StartTransfers answers false
+  // if this loop only reports readiness. Otherwise Read, Write and
+  // CloseTransfers replace read(2), send(2) and close(2) for the handle. They
+  // answer the byte count or 0, or the negated errno, with -EAGAIN when
+  // nothing can be transferred yet. An awaited handle is signalled for
+  // reading when a read has completed and for writing when there is room for
+  // more.
+  virtual bool StartTransfers(intptr_t handle);
+  virtual bool IsTransferring(intptr_t handle);
+  virtual intptr_t CloseTransfers(intptr_t handle);
+  virtual intptr_t Read(intptr_t handle, uint8_t* data, intptr_t length);
+  virtual intptr_t Write(intptr_t handle, const uint8_t* data,
+                         intptr_t length);
+
   Port OpenPort();
   void ClosePort(Port p);
 
+  // Timers scheduled by the program. Their deadlines are folded into the
+  // wakeup passed to MessageEpilogue.
+  TimerWheel* timers() { return &timers_; }
+
  protected:
   void DispatchMessage(IsolateMessage* message);
+  // Dispatches a list of messages linked through next_, all in one
+  // activation when there is more than one.
+  void DispatchMessages(IsolateMessage* messages);
   void DispatchWakeup();
   void DispatchSignal(intptr_t handle,
                       intptr_t status,
@@ -84,6 +114,7 @@ class MessageLoop {
   intptr_t open_ports_;
   intptr_t open_waits_;
   intptr_t exit_code_;
+  TimerWheel timers_;
 
  private:
   DISALLOW_COPY_AND_ASSIGN(MessageLoop);
@@ -99,6 +130,7 @@ class MessageLoop {
 #include "vm/message_loop_fuchsia.h"
 #elif defined(OS_LINUX)
 #include "vm/message_loop_epoll.h"
+#include "vm/message_loop_io_uring.h"
 #elif defined(OS_MACOS)
 #include "vm/message_loop_kqueue.h"
 #elif defined(OS_WINDOWS)
@@ -94,27 +94,36 @@ intptr_t EPollMessageLoop::AwaitSignal(intptr_t fd, intptr_t signals) {
 
   int status = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
   if (status == -1) {
-    FATAL("Failed to add to epoll");
+    return -errno;
   }
+  open_waits_++;
   return fd;
 }
 
 void EPollMessageLoop::CancelSignalWait(intptr_t wait_id) {
-  UNIMPLEMENTED();
+  int status = epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, wait_id, NULL);
+  if (status == -1) {
+    FATAL("Failed to remove from epoll");
+  }
+  open_waits_--;
 }
 
 void EPollMessageLoop::MessageEpilogue(int64_t new_wakeup) {
-  wakeup_ = new_wakeup;
-
-  struct itimerspec it;
-  memset(&it, 0, sizeof(it));
-  if (new_wakeup != 0) {
-    it.it_value.tv_sec = new_wakeup / kNanosecondsPerSecond;
-    it.it_value.tv_nsec = new_wakeup % kNanosecondsPerSecond;
+  // Most messages leave the next wakeup unchanged, so only reprogram the
+  // timer when it moves.
+  if (new_wakeup != wakeup_) {
+    wakeup_ = new_wakeup;
+
+    struct itimerspec it;
+    memset(&it, 0, sizeof(it));
+    if (new_wakeup != 0) {
+      it.it_value.tv_sec = new_wakeup / kNanosecondsPerSecond;
+      it.it_value.tv_nsec = new_wakeup % kNanosecondsPerSecond;
+    }
+    timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &it, NULL);
   }
-  timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &it, NULL);
 
-  if ((open_ports_ == 0) && (wakeup_ == 0)) {
+  if ((open_ports_ == 0) && (open_waits_ == 0) && (wakeup_ == 0)) {
     Exit(0);
   }
 }
@@ -173,6 +182,7 @@ intptr_t EPollMessageLoop::Run() {
           int64_t value;
           ssize_t ignore = read(timer_fd_, &value, sizeof(value));
           (void)ignore;
+          wakeup_ = 0;  // The timer is disarmed once it fires.
           DispatchWakeup();
         } else {
           intptr_t fd = events[i].data.fd;
@@ -197,12 +207,7 @@ intptr_t EPollMessageLoop::Run() {
       }
     }
 
-    IsolateMessage* message = TakeMessages();
-    while (message != NULL) {
-      IsolateMessage* next = message->next_;
-      DispatchMessage(message);
-      message = next;
-    }
+    DispatchMessages(TakeMessages());
   }
 
   if (open_ports_ > 0) {
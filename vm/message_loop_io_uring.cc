@@ -0,0 +1,966 @@
+// Copyright (c) 2018, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "vm/globals.h"  // NOLINT
+#if defined(OS_LINUX)
+
+#include "vm/message_loop.h"
+
+// Multishot polls need the io_uring interface of Linux 5.13. Against older
+// kernel headers the backend compiles to a stub that is never selected.
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#if defined(IORING_POLL_ADD_MULTI) && defined(IORING_FEAT_RSRC_TAGS)
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "vm/lockers.h"
+#include "vm/os.h"
+
+namespace psoup {
+
+static const uint32_t kRingEntries = 256;
+
+// Each transferring descriptor owns a read buffer and a write buffer, which
+// are allocated kChunkBuffers at a time.
+static const intptr_t kBufferSize = 8 * KB;
+static const intptr_t kChunkBuffers = 32;
+
+// The low bits of a request's user_data say what it was for. Polls also
+// carry the fd and, like timers, a token in the high bits. Transfers carry
+// their buffer instead of the fd.
+enum {
+  kWakeupRequest = 1,
+  kTimerRequest = 2,
+  kRemoveRequest = 3,
+  kPollRequest = 4,
+  kReadyRequest = 5,
+  kReadRequest = 6,
+  kWriteRequest = 7,
+  kTransferPollRequest = 8,
+};
+static const intptr_t kRequestKindBits = 4;
+static const uint64_t kRequestKindMask = (1 << kRequestKindBits) - 1;
+
+static uint64_t UserData(uint32_t token, intptr_t fd, intptr_t kind) {
+  return (static_cast<uint64_t>(token) << 32) |
+         (static_cast<uint64_t>(fd) << kRequestKindBits) | kind;
+}
+
+static int SetupRing(uint32_t entries, struct io_uring_params* params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int Register(int ring_fd, unsigned opcode, void* arg, unsigned count) {
+  return syscall(__NR_io_uring_register, ring_fd, opcode, arg, count);
+}
+
+struct IOUringMessageLoop::Descriptor {
+  // Non-zero while the descriptor is awaited. Completions for a wait that
+  // was since cancelled, or cancelled and awaited again, carry another token.
+  uint32_t wait_token;
+  // Zero unless the wait is a poll, which transferring descriptors do not
+  // need.
+  uint32_t poll_events;
+  intptr_t signals;
+
+  bool transferring;
+  // Closed by the program while the write buffer still holds data. The loop
+  // closes the descriptor once that has been sent.
+  bool closing;
+
+  int32_t read_buffer;
+  bool reading;
+  int32_t read_start;
+  int32_t read_end;
+  int32_t read_error;
+  bool read_ended;
+
+  int32_t write_buffer;
+  bool writing;
+  int32_t write_end;
+  int32_t write_error;
+  bool write_refused;
+};
+
+bool IOUringMessageLoop::IsSupported() {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = SetupRing(1, &params);
+  if (fd == -1) {
+    return false;
+  }
+  close(fd);
+  // Multishot polls arrived in the same release as resource tags, which also
+  // brought sparse buffer registration.
+  const uint32_t required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP |
+                            IORING_FEAT_RSRC_TAGS;
+  return (params.features & required) == required;
+}
+
+IOUringMessageLoop::IOUringMessageLoop(Isolate* isolate)
+    : MessageLoop(isolate),
+      mutex_(),
+      head_(NULL),
+      tail_(NULL),
+      wakeup_(0),
+      sq_pending_(0),
+      descriptors_(NULL),
+      descriptor_capacity_(0),
+      next_token_(1),
+      buffers_registered_(false),
+      num_chunks_(0),
+      free_buffers_(NULL),
+      num_free_buffers_(0),
+      buffer_owners_(NULL),
+      armed_wakeup_(0),
+      timer_token_(0) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = 4 * kRingEntries;
+  ring_fd_ = SetupRing(kRingEntries, &params);
+  if (ring_fd_ == -1) {
+    FATAL("Failed to create io_uring");
+  }
+  ASSERT((params.features & IORING_FEAT_SINGLE_MMAP) != 0);
+
+  size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  size_t cq_size = params.cq_off.cqes +
+                   params.cq_entries * sizeof(struct io_uring_cqe);
+  ring_size_ = sq_size > cq_size ? sq_size : cq_size;
+  ring_ = mmap(NULL, ring_size_, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  if (ring_ == MAP_FAILED) {
+    FATAL("Failed to map io_uring");
+  }
+  sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+  void* sqes = mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    FATAL("Failed to map io_uring submissions");
+  }
+  sqes_ = reinterpret_cast<struct io_uring_sqe*>(sqes);
+
+  uint8_t* ring = reinterpret_cast<uint8_t*>(ring_);
+  sq_head_ = reinterpret_cast<uint32_t*>(ring + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<uint32_t*>(ring + params.sq_off.tail);
+  sq_mask_ = *reinterpret_cast<uint32_t*>(ring + params.sq_off.ring_mask);
+  sq_entries_ = params.sq_entries;
+  sq_array_ = reinterpret_cast<uint32_t*>(ring + params.sq_off.array);
+  cq_head_ = reinterpret_cast<uint32_t*>(ring + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<uint32_t*>(ring + params.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<uint32_t*>(ring + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<struct io_uring_cqe*>(ring + params.cq_off.cqes);
+
+  // Registered with the ring as fixed file 0 and polled there, so a wakeup
+  // neither looks the descriptor up nor needs a worker thread to block on it.
+  event_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (event_fd_ == -1) {
+    FATAL("Failed to create eventfd");
+  }
+  if (Register(ring_fd_, IORING_REGISTER_FILES, &event_fd_, 1) != 0) {
+    FATAL("Failed to register eventfd");
+  }
+  ArmWakeupPoll();
+}
+
+IOUringMessageLoop::~IOUringMessageLoop() {
+  // Closing the ring cancels its requests and unpins the buffers.
+  munmap(sqes_, sqes_size_);
+  munmap(ring_, ring_size_);
+  close(ring_fd_);
+  close(event_fd_);
+  for (intptr_t fd = 0; fd < descriptor_capacity_; fd++) {
+    if (descriptors_[fd].closing) {
+      close(fd);
+    }
+  }
+  for (intptr_t i = 0; i < num_chunks_; i++) {
+    chunks_[i].Free();
+  }
+  free(descriptors_);
+  free(free_buffers_);
+  free(buffer_owners_);
+}
+
+struct io_uring_sqe* IOUringMessageLoop::NextSubmission() {
+  uint32_t tail = *sq_tail_;
+  if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) == sq_entries_) {
+    Enter(sq_pending_, 0);
+  }
+  uint32_t index = tail & sq_mask_;
+  struct io_uring_sqe* sqe = &sqes_[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sq_array_[index] = index;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+  sq_pending_++;
+  return sqe;
+}
+
+intptr_t IOUringMessageLoop::Enter(uint32_t to_submit,
+                                   uint32_t min_complete) {
+  uint32_t flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+  int result = syscall(__NR_io_uring_enter, ring_fd_, to_submit,
+                       min_complete, flags, NULL, 0);
+  if (result == -1) {
+    // EBUSY: completions must be reaped before more can be submitted.
+    if ((errno != EINTR) && (errno != EBUSY) && (errno != EAGAIN)) {
+      FATAL("io_uring_enter failed");
+    }
+    return 0;
+  }
+  sq_pending_ -= result;
+  return result;
+}
+
+void IOUringMessageLoop::ArmWakeupPoll() {
+  struct io_uring_sqe* sqe = NextSubmission();
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->flags = IOSQE_FIXED_FILE;
+  sqe->fd = 0;
+  sqe->poll32_events = POLLIN;
+  sqe->len = IORING_POLL_ADD_MULTI;
+  sqe->user_data = UserData(0, 0, kWakeupRequest);
+}
+
+void IOUringMessageLoop::ArmPoll(intptr_t fd) {
+  Descriptor* descriptor = &descriptors_[fd];
+  struct io_uring_sqe* sqe = NextSubmission();
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = descriptor->poll_events;
+  // Multishot polls report each change in readiness rather than the level,
+  // which matches the edge-triggered EPollMessageLoop.
+  sqe->len = IORING_POLL_ADD_MULTI;
+  sqe->user_data = UserData(descriptor->wait_token, fd, kPollRequest);
+}
+
+void IOUringMessageLoop::ArmReady(intptr_t fd) {
+  // Completes at once, so that signals for a transfer that finished before
+  // the wait began are delivered from Run like any other.
+  struct io_uring_sqe* sqe = NextSubmission();
+  sqe->opcode = IORING_OP_NOP;
+  sqe->user_data = UserData(descriptors_[fd].wait_token, fd, kReadyRequest);
+}
+
+void IOUringMessageLoop::UpdateTimer() {
+  if (wakeup_ == armed_wakeup_) {
+    return;
+  }
+  if (armed_wakeup_ != 0) {
+    struct io_uring_sqe* sqe = NextSubmission();
+    sqe->opcode = IORING_OP_TIMEOUT_REMOVE;
+    sqe->addr = UserData(timer_token_, 0, kTimerRequest);
+    sqe->user_data = UserData(0, 0, kRemoveRequest);
+  }
+  armed_wakeup_ = wakeup_;
+  timer_token_++;
+  if (wakeup_ != 0) {
+    // The timespec is read when the request is submitted.
+    timer_spec_.tv_sec = wakeup_ / kNanosecondsPerSecond;
+    timer_spec_.tv_nsec = wakeup_ % kNanosecondsPerSecond;
+    struct io_uring_sqe* sqe = NextSubmission();
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->addr = reinterpret_cast<uint64_t>(&timer_spec_);
+    sqe->len = 1;
+    sqe->timeout_flags = IORING_TIMEOUT_ABS;
+    sqe->user_data = UserData(timer_token_, 0, kTimerRequest);
+  }
+}
+
+IOUringMessageLoop::Descriptor* IOUringMessageLoop::DescriptorAt(
+    intptr_t fd) {
+  ASSERT(fd >= 0);
+  if (fd >= descriptor_capacity_) {
+    intptr_t capacity =
+        descriptor_capacity_ == 0 ? 64 : descriptor_capacity_;
+    while (capacity <= fd) {
+      capacity *= 2;
+    }
+    descriptors_ = reinterpret_cast<Descriptor*>(
+        realloc(descriptors_, capacity * sizeof(Descriptor)));
+    if (descriptors_ == NULL) {
+      FATAL("Out of memory");
+    }
+    memset(&descriptors_[descriptor_capacity_], 0,
+           (capacity - descriptor_capacity_) * sizeof(Descriptor));
+    descriptor_capacity_ = capacity;
+  }
+  return &descriptors_[fd];
+}
+
+intptr_t IOUringMessageLoop::ReadySignals(intptr_t fd) {
+  Descriptor* descriptor = &descriptors_[fd];
+  intptr_t signals = 0;
+  if ((descriptor->read_start < descriptor->read_end) ||
+      descriptor->read_ended || (descriptor->read_error != 0)) {
+    signals |= 1 << kReadEvent;
+  }
+  if (descriptor->read_ended) {
+    signals |= 1 << kCloseEvent;
+  }
+  if ((descriptor->read_error != 0) || (descriptor->write_error != 0)) {
+    signals |= 1 << kErrorEvent;
+  }
+  if ((descriptor->write_end < kBufferSize) ||
+      (descriptor->write_error != 0)) {
+    signals |= 1 << kWriteEvent;
+  }
+  return signals;
+}
+
+void IOUringMessageLoop::Signal(intptr_t fd, intptr_t pending) {
+  Descriptor* descriptor = &descriptors_[fd];
+  if (descriptor->wait_token == 0) {
+    return;  // Found by the next AwaitSignal.
+  }
+  // Like epoll, hang-ups and errors are reported whether awaited or not.
+  pending &= descriptor->signals | (1 << kCloseEvent) | (1 << kErrorEvent);
+  if (pending != 0) {
+    DispatchSignal(fd, 0, pending, 0);
+  }
+}
+
+intptr_t IOUringMessageLoop::AwaitSignal(intptr_t fd, intptr_t signals) {
+  if (fd < 0) {
+    return -EBADF;
+  }
+  Descriptor* descriptor = DescriptorAt(fd);
+  if (descriptor->wait_token != 0) {
+    return -EEXIST;
+  }
+
+  descriptor->signals = signals;
+  descriptor->wait_token = next_token_;
+  next_token_ = next_token_ == UINT32_MAX ? 1 : next_token_ + 1;
+  if (descriptor->transferring) {
+    descriptor->poll_events = 0;
+    if (((signals & (1 << kReadEvent)) != 0) && !descriptor->reading &&
+        (descriptor->read_start == descriptor->read_end) &&
+        !descriptor->read_ended && (descriptor->read_error == 0)) {
+      SubmitRead(fd);
+    }
+    const intptr_t reported =
+        signals | (1 << kCloseEvent) | (1 << kErrorEvent);
+    if ((ReadySignals(fd) & reported) != 0) {
+      ArmReady(fd);
+    }
+  } else {
+    uint32_t events = POLLRDHUP;
+    if (signals & (1 << kReadEvent)) {
+      events |= POLLIN;
+    }
+    if (signals & (1 << kWriteEvent)) {
+      events |= POLLOUT;
+    }
+    descriptor->poll_events = events;
+    ArmPoll(fd);
+  }
+  open_waits_++;
+  return fd;
+}
+
+void IOUringMessageLoop::CancelSignalWait(intptr_t wait_id) {
+  if ((wait_id < 0) || (wait_id >= descriptor_capacity_) ||
+      (descriptors_[wait_id].wait_token == 0)) {
+    FATAL("Failed to remove poll");
+  }
+  Descriptor* descriptor = &descriptors_[wait_id];
+  if (descriptor->poll_events != 0) {
+    struct io_uring_sqe* sqe = NextSubmission();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->addr = UserData(descriptor->wait_token, wait_id, kPollRequest);
+    sqe->user_data = UserData(0, 0, kRemoveRequest);
+  }
+  descriptor->wait_token = 0;
+  open_waits_--;
+}
+
+bool IOUringMessageLoop::AddChunk() {
+  if (num_chunks_ == kMaxChunks) {
+    return false;
+  }
+  const intptr_t max_buffers = kMaxChunks * kChunkBuffers;
+  if (num_chunks_ == 0) {
+    free_buffers_ =
+        reinterpret_cast<int32_t*>(malloc(max_buffers * sizeof(int32_t)));
+    buffer_owners_ =
+        reinterpret_cast<int32_t*>(malloc(max_buffers * sizeof(int32_t)));
+    if ((free_buffers_ == NULL) || (buffer_owners_ == NULL)) {
+      FATAL("Out of memory");
+    }
+    // A table of empty slots, so that each chunk can be registered as it is
+    // allocated.
+    struct iovec* slots = reinterpret_cast<struct iovec*>(
+        calloc(max_buffers, sizeof(struct iovec)));
+    if (slots == NULL) {
+      FATAL("Out of memory");
+    }
+    struct io_uring_rsrc_register table;
+    memset(&table, 0, sizeof(table));
+    table.nr = max_buffers;
+    table.data = reinterpret_cast<uint64_t>(slots);
+    buffers_registered_ = Register(ring_fd_, IORING_REGISTER_BUFFERS2,
+                                   &table, sizeof(table)) == 0;
+    free(slots);
+  }
+
+  intptr_t chunk = num_chunks_++;
+  chunks_[chunk] = VirtualMemory::Allocate(kChunkBuffers * kBufferSize,
+                                           VirtualMemory::kReadWrite,
+                                           "io_uring buffers");
+  chunk_registered_[chunk] = false;
+  if (buffers_registered_) {
+    struct iovec buffers[kChunkBuffers];
+    for (intptr_t i = 0; i < kChunkBuffers; i++) {
+      buffers[i].iov_base =
+          reinterpret_cast<void*>(chunks_[chunk].base() + i * kBufferSize);
+      buffers[i].iov_len = kBufferSize;
+    }
+    struct io_uring_rsrc_update2 update;
+    memset(&update, 0, sizeof(update));
+    update.offset = chunk * kChunkBuffers;
+    update.data = reinterpret_cast<uint64_t>(buffers);
+    update.nr = kChunkBuffers;
+    chunk_registered_[chunk] =
+        Register(ring_fd_, IORING_REGISTER_BUFFERS_UPDATE, &update,
+                 sizeof(update)) == kChunkBuffers;
+  }
+  for (intptr_t i = kChunkBuffers - 1; i >= 0; i--) {
+    free_buffers_[num_free_buffers_++] = chunk * kChunkBuffers + i;
+  }
+  return true;
+}
+
+intptr_t IOUringMessageLoop::TakeBuffer() {
+  if ((num_free_buffers_ == 0) && !AddChunk()) {
+    return -1;
+  }
+  return free_buffers_[--num_free_buffers_];
+}
+
+void IOUringMessageLoop::ReleaseBuffer(intptr_t buffer) {
+  free_buffers_[num_free_buffers_++] = buffer;
+}
+
+uint8_t* IOUringMessageLoop::BufferAt(intptr_t buffer) {
+  return reinterpret_cast<uint8_t*>(chunks_[buffer / kChunkBuffers].base()) +
+         (buffer % kChunkBuffers) * kBufferSize;
+}
+
+bool IOUringMessageLoop::StartTransfers(intptr_t fd) {
+  if (fd < 0) {
+    return false;
+  }
+  Descriptor* descriptor = DescriptorAt(fd);
+  if (descriptor->transferring) {
+    return true;
+  }
+  ASSERT(!descriptor->closing);
+  if (descriptor->wait_token != 0) {
+    return false;  // Already polled.
+  }
+  intptr_t read_buffer = TakeBuffer();
+  if (read_buffer == -1) {
+    return false;
+  }
+  intptr_t write_buffer = TakeBuffer();
+  if (write_buffer == -1) {
+    ReleaseBuffer(read_buffer);
+    return false;
+  }
+  buffer_owners_[read_buffer] = fd;
+  buffer_owners_[write_buffer] = fd;
+
+  descriptor->transferring = true;
+  descriptor->read_buffer = read_buffer;
+  descriptor->reading = false;
+  descriptor->read_start = 0;
+  descriptor->read_end = 0;
+  descriptor->read_error = 0;
+  descriptor->read_ended = false;
+  descriptor->write_buffer = write_buffer;
+  descriptor->writing = false;
+  descriptor->write_end = 0;
+  descriptor->write_error = 0;
+  descriptor->write_refused = false;
+  return true;
+}
+
+bool IOUringMessageLoop::IsTransferring(intptr_t fd) {
+  return (fd >= 0) && (fd < descriptor_capacity_) &&
+         descriptors_[fd].transferring;
+}
+
+intptr_t IOUringMessageLoop::CloseTransfers(intptr_t fd) {
+  ASSERT(IsTransferring(fd));
+  Descriptor* descriptor = &descriptors_[fd];
+  descriptor->transferring = false;
+
+  if (descriptor->reading) {
+    // The buffer is released when the read or its poll completes.
+    CancelTransfer(descriptor->read_buffer, kReadRequest);
+    CancelTransfer(descriptor->read_buffer, kTransferPollRequest);
+    buffer_owners_[descriptor->read_buffer] = -1;
+  } else {
+    ReleaseBuffer(descriptor->read_buffer);
+  }
+
+  if (descriptor->writing) {
+    // Like close(2) on a socket, what was written is still sent.
+    descriptor->closing = true;
+    return 0;
+  }
+  ReleaseBuffer(descriptor->write_buffer);
+  // Requests naming the descriptor must be submitted while it still refers
+  // to this socket.
+  if (sq_pending_ > 0) {
+    Enter(sq_pending_, 0);
+  }
+  if (close(fd) == -1) {
+    return -errno;
+  }
+  return 0;
+}
+
+intptr_t IOUringMessageLoop::Read(intptr_t fd, uint8_t* data,
+                                  intptr_t length) {
+  ASSERT(IsTransferring(fd));
+  Descriptor* descriptor = &descriptors_[fd];
+  if (descriptor->read_start < descriptor->read_end) {
+    intptr_t count = descriptor->read_end - descriptor->read_start;
+    if (count > length) {
+      count = length;
+    }
+    memcpy(data, BufferAt(descriptor->read_buffer) + descriptor->read_start,
+           count);
+    descriptor->read_start += count;
+    if (descriptor->read_start == descriptor->read_end) {
+      descriptor->read_start = descriptor->read_end = 0;
+      SubmitRead(fd);
+    }
+    return count;
+  }
+  if (descriptor->read_error != 0) {
+    return descriptor->read_error;
+  }
+  if (descriptor->read_ended) {
+    return 0;
+  }
+  if (!descriptor->reading) {
+    SubmitRead(fd);
+  }
+  return -EAGAIN;
+}
+
+intptr_t IOUringMessageLoop::Write(intptr_t fd, const uint8_t* data,
+                                   intptr_t length) {
+  ASSERT(IsTransferring(fd));
+  Descriptor* descriptor = &descriptors_[fd];
+  if (descriptor->write_error != 0) {
+    return descriptor->write_error;
+  }
+  intptr_t count = kBufferSize - descriptor->write_end;
+  if (count >= length) {
+    count = length;
+  } else {
+    descriptor->write_refused = true;
+  }
+  if (count == 0) {
+    return -EAGAIN;
+  }
+  // A send in flight covers only bytes before write_end, so more can be
+  // appended behind it.
+  memcpy(BufferAt(descriptor->write_buffer) + descriptor->write_end, data,
+         count);
+  descriptor->write_end += count;
+  if (!descriptor->writing) {
+    SubmitWrite(fd);
+  }
+  return count;
+}
+
+void IOUringMessageLoop::SubmitRead(intptr_t fd) {
+  Descriptor* descriptor = &descriptors_[fd];
+  intptr_t buffer = descriptor->read_buffer;
+  struct io_uring_sqe* sqe = NextSubmission();
+  if (chunk_registered_[buffer / kChunkBuffers]) {
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->buf_index = buffer;
+  } else {
+    sqe->opcode = IORING_OP_READ;
+  }
+  sqe->fd = fd;
+  sqe->off = static_cast<uint64_t>(-1);  // Sockets have no position.
+  sqe->addr = reinterpret_cast<uint64_t>(BufferAt(buffer));
+  sqe->len = kBufferSize;
+  sqe->user_data = UserData(0, buffer, kReadRequest);
+  descriptor->reading = true;
+}
+
+void IOUringMessageLoop::SubmitWrite(intptr_t fd) {
+  // send rather than write, so that a peer that has gone away produces EPIPE
+  // instead of SIGPIPE.
+  Descriptor* descriptor = &descriptors_[fd];
+  intptr_t buffer = descriptor->write_buffer;
+  struct io_uring_sqe* sqe = NextSubmission();
+  sqe->opcode = IORING_OP_SEND;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(BufferAt(buffer));
+  sqe->len = descriptor->write_end;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  sqe->user_data = UserData(0, buffer, kWriteRequest);
+  descriptor->writing = true;
+}
+
+void IOUringMessageLoop::SubmitTransferPoll(intptr_t fd,
+                                            intptr_t buffer,
+                                            uint32_t events) {
+  // Kernels that answer EAGAIN for a non-blocking socket instead of waiting
+  // in the ring get the transfer retried once the socket is ready.
+  struct io_uring_sqe* sqe = NextSubmission();
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = events;
+  sqe->user_data = UserData(0, buffer, kTransferPollRequest);
+}
+
+void IOUringMessageLoop::CancelTransfer(intptr_t buffer, intptr_t kind) {
+  struct io_uring_sqe* sqe = NextSubmission();
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->addr = UserData(0, buffer, kind);
+  sqe->user_data = UserData(0, 0, kRemoveRequest);
+}
+
+void IOUringMessageLoop::HandleRead(intptr_t buffer, int32_t result) {
+  intptr_t fd = buffer_owners_[buffer];
+  if (fd == -1) {
+    ReleaseBuffer(buffer);  // Closed meanwhile.
+    return;
+  }
+  Descriptor* descriptor = &descriptors_[fd];
+  if (result == -EAGAIN) {
+    SubmitTransferPoll(fd, buffer, POLLIN | POLLRDHUP);
+    return;
+  }
+  descriptor->reading = false;
+  if (result > 0) {
+    descriptor->read_start = 0;
+    descriptor->read_end = result;
+  } else if (result == 0) {
+    descriptor->read_ended = true;
+  } else {
+    descriptor->read_error = result;
+  }
+  Signal(fd, ReadySignals(fd) & ~(1 << kWriteEvent));
+}
+
+void IOUringMessageLoop::HandleWrite(intptr_t buffer, int32_t result) {
+  intptr_t fd = buffer_owners_[buffer];
+  ASSERT(fd != -1);
+  Descriptor* descriptor = &descriptors_[fd];
+  if (result == -EAGAIN) {
+    SubmitTransferPoll(fd, buffer, POLLOUT);
+    return;
+  }
+  descriptor->writing = false;
+  if (result < 0) {
+    descriptor->write_error = result;
+    descriptor->write_end = 0;
+  } else {
+    uint8_t* data = BufferAt(buffer);
+    memmove(data, data + result, descriptor->write_end - result);
+    descriptor->write_end -= result;
+    if (descriptor->write_end > 0) {
+      SubmitWrite(fd);
+    }
+  }
+
+  if (descriptor->closing) {
+    if (!descriptor->writing) {
+      descriptor->closing = false;
+      ReleaseBuffer(buffer);
+      close(fd);
+    }
+    return;
+  }
+  if (descriptor->write_refused || (result < 0)) {
+    descriptor->write_refused = false;
+    intptr_t pending = 1 << kWriteEvent;
+    if (result < 0) {
+      pending |= 1 << kErrorEvent;
+    }
+    Signal(fd, pending);
+  }
+}
+
+void IOUringMessageLoop::HandleTransferPoll(intptr_t buffer,
+                                            int32_t result) {
+  intptr_t fd = buffer_owners_[buffer];
+  if (fd == -1) {
+    ReleaseBuffer(buffer);  // Closed meanwhile.
+    return;
+  }
+  Descriptor* descriptor = &descriptors_[fd];
+  if (buffer == descriptor->read_buffer) {
+    if (result < 0) {
+      HandleRead(buffer, result);
+    } else {
+      SubmitRead(fd);
+    }
+  } else {
+    if (result < 0) {
+      HandleWrite(buffer, result);
+    } else {
+      SubmitWrite(fd);
+    }
+  }
+}
+
+void IOUringMessageLoop::MessageEpilogue(int64_t new_wakeup) {
+  // The timer is rearmed with the next batch of submissions.
+  wakeup_ = new_wakeup;
+
+  if ((open_ports_ == 0) && (open_waits_ == 0) && (wakeup_ == 0)) {
+    Exit(0);
+  }
+}
+
+void IOUringMessageLoop::Exit(intptr_t exit_code) {
+  exit_code_ = exit_code;
+  isolate_ = NULL;
+}
+
+void IOUringMessageLoop::PostMessage(IsolateMessage* message) {
+  MutexLocker locker(&mutex_);
+  if (head_ == NULL) {
+    head_ = tail_ = message;
+    Notify();
+  } else {
+    tail_->next_ = message;
+    tail_ = message;
+  }
+}
+
+void IOUringMessageLoop::Notify() {
+  uint64_t increment = 1;
+  ssize_t written = write(event_fd_, &increment, sizeof(increment));
+  if (written != sizeof(increment)) {
+    FATAL("Failed to signal eventfd");
+  }
+}
+
+IsolateMessage* IOUringMessageLoop::TakeMessages() {
+  MutexLocker locker(&mutex_);
+  IsolateMessage* message = head_;
+  head_ = tail_ = NULL;
+  return message;
+}
+
+void IOUringMessageLoop::HandleCompletion(uint64_t user_data,
+                                          int32_t result,
+                                          uint32_t flags) {
+  uint32_t token = static_cast<uint32_t>(user_data >> 32);
+  intptr_t fd = static_cast<uint32_t>(user_data) >> kRequestKindBits;
+  switch (user_data & kRequestKindMask) {
+    case kWakeupRequest: {
+      uint64_t value;
+      if ((read(event_fd_, &value, sizeof(value)) == -1) &&
+          (errno != EAGAIN)) {
+        FATAL("Failed to read eventfd");
+      }
+      if ((flags & IORING_CQE_F_MORE) == 0) {
+        ArmWakeupPoll();
+      }
+      break;
+    }
+    case kTimerRequest:
+      if ((token == timer_token_) && (result != -ECANCELED)) {
+        armed_wakeup_ = 0;
+        DispatchWakeup();
+      }
+      break;
+    case kRemoveRequest:
+      break;
+    case kPollRequest: {
+      if (descriptors_[fd].wait_token != token) {
+        break;  // Cancelled.
+      }
+      intptr_t pending = 0;
+      if (result < 0) {
+        pending |= 1 << kErrorEvent;
+      } else {
+        if (result & POLLERR) {
+          pending |= 1 << kErrorEvent;
+        }
+        if (result & POLLIN) {
+          pending |= 1 << kReadEvent;
+        }
+        if (result & POLLOUT) {
+          pending |= 1 << kWriteEvent;
+        }
+        if (result & (POLLHUP | POLLRDHUP)) {
+          pending |= 1 << kCloseEvent;
+        }
+      }
+      DispatchSignal(fd, 0, pending, 0);
+      if ((result >= 0) && ((flags & IORING_CQE_F_MORE) == 0) &&
+          (descriptors_[fd].wait_token == token)) {
+        ArmPoll(fd);  // The kernel ended the multishot poll.
+      }
+      break;
+    }
+    case kReadyRequest:
+      if (descriptors_[fd].wait_token == token) {
+        Signal(fd, ReadySignals(fd));
+      }
+      break;
+    case kReadRequest:
+      HandleRead(fd, result);
+      break;
+    case kWriteRequest:
+      HandleWrite(fd, result);
+      break;
+    case kTransferPollRequest:
+      HandleTransferPoll(fd, result);
+      break;
+    default:
+      UNREACHABLE();
+  }
+}
+
+intptr_t IOUringMessageLoop::Run() {
+  while (isolate_ != NULL) {
+    UpdateTimer();
+    Enter(sq_pending_, 1);
+
+    uint32_t head = *cq_head_;
+    while (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+      struct io_uring_cqe* cqe = &cqes_[head & cq_mask_];
+      uint64_t user_data = cqe->user_data;
+      int32_t result = cqe->res;
+      uint32_t flags = cqe->flags;
+      head++;
+      // Release the entry before dispatching, which may take a while.
+      __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+      HandleCompletion(user_data, result, flags);
+    }
+
+    DispatchMessages(TakeMessages());
+  }
+
+  if (open_ports_ > 0) {
+    PortMap::CloseAllPorts(this);
+  }
+
+  while (head_ != NULL) {
+    IsolateMessage* message = head_;
+    head_ = message->next_;
+    delete message;
+  }
+
+  return exit_code_;
+}
+
+void IOUringMessageLoop::Interrupt() {
+  Exit(SIGINT);
+  Notify();
+}
+
+}  // namespace psoup
+
+#else  // !defined(IORING_POLL_ADD_MULTI) || !defined(IORING_FEAT_RSRC_TAGS)
+
+#include "vm/assert.h"
+
+namespace psoup {
+
+bool IOUringMessageLoop::IsSupported() {
+  return false;
+}
+
+IOUringMessageLoop::IOUringMessageLoop(Isolate* isolate)
+    : MessageLoop(isolate) {
+  UNREACHABLE();
+}
+
+IOUringMessageLoop::~IOUringMessageLoop() {}
+
+void IOUringMessageLoop::PostMessage(IsolateMessage* message) {
+  UNREACHABLE();
+}
+
+intptr_t IOUringMessageLoop::AwaitSignal(intptr_t handle, intptr_t signals) {
+  UNREACHABLE();
+  return 0;
+}
+
+void IOUringMessageLoop::CancelSignalWait(intptr_t wait_id) {
+  UNREACHABLE();
+}
+
+void IOUringMessageLoop::MessageEpilogue(int64_t new_wakeup) {
+  UNREACHABLE();
+}
+
+void IOUringMessageLoop::Exit(intptr_t exit_code) {
+  UNREACHABLE();
+}
+
+intptr_t IOUringMessageLoop::Run() {
+  UNREACHABLE();
+  return 0;
+}
+
+void IOUringMessageLoop::Interrupt() {
+  UNREACHABLE();
+}
+
+bool IOUringMessageLoop::StartTransfers(intptr_t handle) {
+  UNREACHABLE();
+  return false;
+}
+
+bool IOUringMessageLoop::IsTransferring(intptr_t handle) {
+  UNREACHABLE();
+  return false;
+}
+
+intptr_t IOUringMessageLoop::CloseTransfers(intptr_t handle) {
+  UNREACHABLE();
+  return 0;
+}
+
+intptr_t IOUringMessageLoop::Read(intptr_t handle, uint8_t* data,
+                                  intptr_t length) {
+  UNREACHABLE();
+  return 0;
+}
+
+intptr_t IOUringMessageLoop::Write(intptr_t handle, const uint8_t* data,
+                                   intptr_t length) {
+  UNREACHABLE();
+  return 0;
+}
+
+}  // namespace psoup
+
+#endif  // defined(IORING_POLL_ADD_MULTI) && defined(IORING_FEAT_RSRC_TAGS)
+
+#endif  // defined(OS_LINUX)
@@ -0,0 +1,134 @@
+// Copyright (c) 2018, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef VM_MESSAGE_LOOP_IO_URING_H_
+#define VM_MESSAGE_LOOP_IO_URING_H_
+
+#if !defined(VM_MESSAGE_LOOP_H_)
+#error Do not include message_loop_io_uring.h directly; use message_loop.h \
+  instead.
+#endif
+
+#include <time.h>
+
+#include "vm/message_loop.h"
+#include "vm/thread.h"
+#include "vm/virtual_memory.h"
+
+struct io_uring_cqe;
+struct io_uring_sqe;
+
+namespace psoup {
+
+// An alternative to EPollMessageLoop for Linux. Waits, timers and wakeups are
+// requests on an io_uring: requests made while handling a message are only
+// queued, and each turn of Run submits all of them and waits for completions
+// with a single system call. Sockets that start transfers are not polled:
+// the ring reads into and sends from buffers registered with it, and the
+// program copies data in and out of those buffers instead of calling read(2)
+// and send(2) itself. Other descriptors are polled for readiness.
+class IOUringMessageLoop : public MessageLoop {
+ public:
+  explicit IOUringMessageLoop(Isolate* isolate);
+  ~IOUringMessageLoop();
+
+  static bool IsSupported();
+
+  void PostMessage(IsolateMessage* message);
+  intptr_t AwaitSignal(intptr_t handle, intptr_t signals);
+  void CancelSignalWait(intptr_t wait_id);
+  void MessageEpilogue(int64_t new_wakeup);
+  void Exit(intptr_t exit_code);
+
+  intptr_t Run();
+  void Interrupt();
+
+  bool StartTransfers(intptr_t handle);
+  bool IsTransferring(intptr_t handle);
+  intptr_t CloseTransfers(intptr_t handle);
+  intptr_t Read(intptr_t handle, uint8_t* data, intptr_t length);
+  intptr_t Write(intptr_t handle, const uint8_t* data, intptr_t length);
+
+ private:
+  struct Descriptor;
+
+  static const intptr_t kMaxChunks = 32;
+
+  IsolateMessage* TakeMessages();
+  void Notify();
+
+  io_uring_sqe* NextSubmission();
+  intptr_t Enter(uint32_t to_submit, uint32_t min_complete);
+  void ArmWakeupPoll();
+  void ArmPoll(intptr_t fd);
+  void ArmReady(intptr_t fd);
+  void UpdateTimer();
+  Descriptor* DescriptorAt(intptr_t fd);
+  intptr_t ReadySignals(intptr_t fd);
+  void Signal(intptr_t fd, intptr_t pending);
+
+  bool AddChunk();
+  intptr_t TakeBuffer();
+  void ReleaseBuffer(intptr_t buffer);
+  uint8_t* BufferAt(intptr_t buffer);
+  void SubmitRead(intptr_t fd);
+  void SubmitWrite(intptr_t fd);
+  void SubmitTransferPoll(intptr_t fd, intptr_t buffer, uint32_t events);
+  void CancelTransfer(intptr_t buffer, intptr_t kind);
+  void HandleRead(intptr_t buffer, int32_t result);
+  void HandleWrite(intptr_t buffer, int32_t result);
+  void HandleTransferPoll(intptr_t buffer, int32_t result);
+  void HandleCompletion(uint64_t user_data, int32_t result, uint32_t flags);
+
+  Mutex mutex_;
+  IsolateMessage* head_;
+  IsolateMessage* tail_;
+  int64_t wakeup_;
+
+  int ring_fd_;
+  int event_fd_;
+
+  // The submission and completion queues share one mapping.
+  void* ring_;
+  size_t ring_size_;
+  uint32_t* sq_head_;
+  uint32_t* sq_tail_;
+  uint32_t sq_mask_;
+  uint32_t sq_entries_;
+  uint32_t* sq_array_;
+  io_uring_sqe* sqes_;
+  size_t sqes_size_;
+  uint32_t sq_pending_;
+  uint32_t* cq_head_;
+  uint32_t* cq_tail_;
+  uint32_t cq_mask_;
+  io_uring_cqe* cqes_;
+
+  Descriptor* descriptors_;
+  intptr_t descriptor_capacity_;
+  uint32_t next_token_;
+
+  // Transfer buffers are allocated a chunk at a time and registered with the
+  // ring, which pins them. A chunk the ring refuses to register, for instance
+  // because it would exceed RLIMIT_MEMLOCK, is used unregistered.
+  bool buffers_registered_;
+  VirtualMemory chunks_[kMaxChunks];
+  bool chunk_registered_[kMaxChunks];
+  intptr_t num_chunks_;
+  int32_t* free_buffers_;
+  intptr_t num_free_buffers_;
+  // The descriptor each buffer belongs to, or -1 once the descriptor is
+  // closed while a request still uses the buffer.
+  int32_t* buffer_owners_;
+
+  int64_t armed_wakeup_;
+  uint32_t timer_token_;
+  struct timespec timer_spec_;
+
+  DISALLOW_COPY_AND_ASSIGN(IOUringMessageLoop);
+};
+
+}  // namespace psoup
+
+#endif  // VM_MESSAGE_LOOP_IO_URING_H_
@@ -113,12 +113,7 @@ intptr_t IOCPMessageLoop::Run() {
       UNIMPLEMENTED();
     }
 
-    IsolateMessage* message = TakeMessages();
-    while (message != NULL) {
-      IsolateMessage* next = message->next_;
-      DispatchMessage(message);
-      message = next;
-    }
+    DispatchMessages(TakeMessages());
   }
 
   if (open_ports_ > 0) {
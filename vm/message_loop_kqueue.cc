@@ -85,20 +85,26 @@ intptr_t KQueueMessageLoop::AwaitSignal(intptr_t fd, intptr_t signals) {
   ASSERT(nchanges <= kMaxChanges);
   int status = kevent(kqueue_fd_, changes, nchanges, NULL, 0, NULL);
   if (status == -1) {
-    FATAL("Failed to add to kqueue");
+    return -errno;
   }
-
+  open_waits_++;
   return fd;
 }
 
 void KQueueMessageLoop::CancelSignalWait(intptr_t wait_id) {
-  UNIMPLEMENTED();
+  // Only one of the filters may have been added; the other fails harmlessly.
+  struct kevent change;
+  EV_SET(&change, wait_id, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+  kevent(kqueue_fd_, &change, 1, NULL, 0, NULL);
+  EV_SET(&change, wait_id, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+  kevent(kqueue_fd_, &change, 1, NULL, 0, NULL);
+  open_waits_--;
 }
 
 void KQueueMessageLoop::MessageEpilogue(int64_t new_wakeup) {
   wakeup_ = new_wakeup;
 
-  if ((open_ports_ == 0) && (wakeup_ == 0)) {
+  if ((open_ports_ == 0) && (open_waits_ == 0) && (wakeup_ == 0)) {
     Exit(0);
   }
 }
@@ -198,12 +204,7 @@ intptr_t KQueueMessageLoop::Run() {
       }
     }
 
-    IsolateMessage* message = TakeMessages();
-    while (message != NULL) {
-      IsolateMessage* next = message->next_;
-      DispatchMessage(message);
-      message = next;
-    }
+    DispatchMessages(TakeMessages());
   }
 
   if (open_ports_ > 0) {
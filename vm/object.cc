@@ -108,10 +108,10 @@ void HeapObject::Pointers(Object*** from, Object*** to) {
 }
 
 
-void HeapObject::AddToRememberedSet() const {
+void HeapObject::AddToRememberedSet(Object** slot) const {
   Isolate* isolate = Isolate::Current();
   ASSERT(isolate != NULL);
-  isolate->heap()->AddToRememberedSet(const_cast<HeapObject*>(this));
+  isolate->heap()->RememberStore(const_cast<HeapObject*>(this), slot);
 }
 
 
@@ -44,6 +44,11 @@ enum HeaderBits {
   // For symbols.
   kCanonicalBit = 2,
 
+  // New object: number of scavenges survived, saturating. Meaningless for old
+  // objects.
+  kAgeFieldOffset = 3,
+  kAgeFieldSize = 3,
+
 #if defined(ARCH_IS_32_BIT)
   kSizeFieldOffset = 8,
   kSizeFieldSize = 8,
@@ -199,6 +204,12 @@ class HeapObject : public Object {
   void set_is_canonical(bool value) {
     ptr()->header_ = CanonicalBit::update(value, ptr()->header_);
   }
+  intptr_t age() const {
+    return AgeField::decode(ptr()->header_);
+  }
+  void set_age(intptr_t value) {
+    ptr()->header_ = AgeField::update(value, ptr()->header_);
+  }
   intptr_t heap_size() const {
     return SizeField::decode(ptr()->header_) << kObjectAlignmentLog2;
   }
@@ -264,7 +275,7 @@ class HeapObject : public Object {
     } else {
       // Generational write barrier:
       if (IsOldObject() && value->IsNewObject() && !is_remembered()) {
-        AddToRememberedSet();
+        AddToRememberedSet(reinterpret_cast<Object**>(addr));
       }
     }
   }
@@ -273,7 +284,7 @@ class HeapObject : public Object {
   uword header_hash_;
 
  private:
-  void AddToRememberedSet() const;
+  void AddToRememberedSet(Object** slot) const;
 
   const HeapObject* ptr() const {
     ASSERT(IsHeapObject());
@@ -289,6 +300,7 @@ class HeapObject : public Object {
   class MarkBit : public BitField<bool, kMarkBit, 1> {};
   class RememberedBit : public BitField<bool, kRememberedBit, 1> {};
   class CanonicalBit : public BitField<bool, kCanonicalBit, 1> {};
+  class AgeField : public BitField<intptr_t, kAgeFieldOffset, kAgeFieldSize> {};
   class SizeField :
       public BitField<intptr_t, kSizeFieldOffset, kSizeFieldSize> {};
   class ClassIdField :
@@ -420,6 +432,8 @@ class LargeInteger : public HeapObject {
 
   static LargeInteger* Expand(Object* integer, Heap* H);
   static Object* Reduce(LargeInteger* integer, Heap* H);
+  static LargeInteger* FromUint64(uint64_t value, Heap* H);
+  static bool ToUint64(LargeInteger* integer, uint64_t* value);
 
   static intptr_t Compare(LargeInteger* left, LargeInteger* right);
 
@@ -936,8 +950,17 @@ class ObjectStore : public HeapObject {
   Behavior* WeakArray() const { return ptr()->WeakArray_; }
   Behavior* Activation() const { return ptr()->Activation_; }
   Behavior* Method() const { return ptr()->Method_; }
+  // NULL for snapshots written before it was added.
+  class String* out_of_memory() const {
+    if (size()->value() <= kOutOfMemoryIndex) {
+      return NULL;
+    }
+    return ptr()->out_of_memory_;
+  }
 
  private:
+  static const intptr_t kOutOfMemoryIndex = 25;
+
   class SmallInteger* array_size_;
   Object* nil_;
   Object* false_;
@@ -964,6 +987,7 @@ class ObjectStore : public HeapObject {
   Behavior* WeakArray_;
   Behavior* Activation_;
   Behavior* Method_;
+  class String* out_of_memory_;
 };
 
 }  // namespace psoup
@@ -0,0 +1,100 @@
+// Copyright (c) 2018, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "vm/page_pool.h"
+
+#include "vm/assert.h"
+#include "vm/lockers.h"
+#include "vm/thread.h"
+
+namespace psoup {
+
+Mutex* PagePool::mutex_ = NULL;
+VirtualMemory PagePool::entries_[kMaxEntries];
+intptr_t PagePool::num_entries_ = 0;
+size_t PagePool::size_ = 0;
+size_t PagePool::capacity_ = kDefaultCapacity;
+bool PagePool::numa_local_ = false;
+
+
+void PagePool::Startup() {
+  mutex_ = new Mutex();
+}
+
+
+void PagePool::Shutdown() {
+  for (intptr_t i = 0; i < num_entries_; i++) {
+    entries_[i].Free();
+  }
+  num_entries_ = 0;
+  size_ = 0;
+  delete mutex_;
+  mutex_ = NULL;
+}
+
+
+void PagePool::SetCapacity(size_t capacity) {
+  MutexLocker ml(mutex_);
+  capacity_ = capacity;
+  while (size_ > capacity_) {
+    VirtualMemory memory = entries_[0];
+    RemoveEntry(0);
+    memory.Free();
+  }
+}
+
+
+// Entries are kept in the order they were freed, oldest first.
+void PagePool::RemoveEntry(intptr_t index) {
+  size_ -= entries_[index].size();
+  num_entries_--;
+  for (intptr_t i = index; i < num_entries_; i++) {
+    entries_[i] = entries_[i + 1];
+  }
+}
+
+
+VirtualMemory PagePool::Allocate(size_t size) {
+  if (!numa_local_) {
+    MutexLocker ml(mutex_);
+    // Most recently freed first, since it is the most likely to still be
+    // resident.
+    for (intptr_t i = num_entries_ - 1; i >= 0; i--) {
+      if (entries_[i].size() == size) {
+        VirtualMemory memory = entries_[i];
+        RemoveEntry(i);
+        return memory;
+      }
+    }
+  }
+  return VirtualMemory::Allocate(size, VirtualMemory::kReadWrite,
+                                 "primordialsoup-heap");
+}
+
+
+void PagePool::Free(VirtualMemory memory) {
+  if (numa_local_ || (memory.size() > capacity_ / kMaxRegionFraction)) {
+    memory.Free();
+    return;
+  }
+
+  VirtualMemory evicted[kMaxEntries];
+  intptr_t num_evicted = 0;
+  {
+    MutexLocker ml(mutex_);
+    while ((num_entries_ == kMaxEntries) ||
+           (size_ + memory.size() > capacity_)) {
+      evicted[num_evicted++] = entries_[0];
+      RemoveEntry(0);
+    }
+    entries_[num_entries_++] = memory;
+    size_ += memory.size();
+  }
+  // Unmapped outside the lock.
+  for (intptr_t i = 0; i < num_evicted; i++) {
+    evicted[i].Free();
+  }
+}
+
+}  // namespace psoup
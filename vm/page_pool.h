@@ -0,0 +1,59 @@
+// Copyright (c) 2018, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef VM_PAGE_POOL_H_
+#define VM_PAGE_POOL_H_
+
+#include "vm/allocation.h"
+#include "vm/globals.h"
+#include "vm/virtual_memory.h"
+
+namespace psoup {
+
+class Mutex;
+
+// A process-wide cache of heap memory. Heaps take their semispaces and pages
+// from here and give them back when they are done, so short-lived isolates
+// reuse memory that is already mapped and faulted in instead of paying for
+// mmap, page faults and munmap on every spawn. Regions are only reused for
+// requests of exactly the same size, which is the common case since heaps
+// start out alike. When the pool is full the oldest regions make way, and
+// regions too large to be worth keeping, such as fully grown semispaces, are
+// not kept at all. The contents of a reused region are undefined.
+class PagePool : public AllStatic {
+ public:
+  static void Startup();
+  static void Shutdown();
+
+  // Bounds the bytes kept for reuse. 0 disables the pool.
+  static void SetCapacity(size_t capacity);
+  // NUMA-local placement relies on memory being faulted in by the thread
+  // that will use it, but pooled memory was faulted in on whichever node
+  // freed it, so the pool is bypassed while this is set. Set before any
+  // isolate starts.
+  static void SetNumaLocal(bool enabled) { numa_local_ = enabled; }
+
+  static VirtualMemory Allocate(size_t size);
+  // Keeps memory for reuse if there is room, otherwise returns it to the OS.
+  static void Free(VirtualMemory memory);
+
+ private:
+  static const intptr_t kMaxEntries = 64;
+  static const size_t kDefaultCapacity = 32 * MB;
+  // Regions above this fraction of the capacity are returned to the OS.
+  static const size_t kMaxRegionFraction = 8;
+
+  static void RemoveEntry(intptr_t index);
+
+  static Mutex* mutex_;
+  static VirtualMemory entries_[kMaxEntries];
+  static intptr_t num_entries_;
+  static size_t size_;
+  static size_t capacity_;
+  static bool numa_local_;
+};
+
+}  // namespace psoup
+
+#endif  // VM_PAGE_POOL_H_
@@ -13,6 +13,18 @@
 #include <emscripten.h>
 #endif
 
+#if defined(OS_ANDROID) || defined(OS_LINUX) || defined(OS_MACOS)
+#define USING_POSIX_IO 1
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
 #include "vm/assert.h"
 #include "vm/double_conversion.h"
 #include "vm/heap.h"
@@ -22,6 +34,7 @@
 #include "vm/message_loop.h"
 #include "vm/object.h"
 #include "vm/os.h"
+#include "vm/utils.h"
 
 #define nil I->nil_obj()
 
@@ -188,7 +201,65 @@ const bool kFailure = false;
   V(162, JS_performDelete)                                                     \
   V(163, JS_performInvoke)                                                     \
   V(164, JS_performNew)                                                        \
+  V(165, executionCounters)                                                    \
+  V(166, heapCensus)                                                           \
+  V(167, heapDump)                                                             \
+  V(168, Activation_nextMarkedSenderUpTo)                                      \
+  V(169, ByteArray_uint16At)                                                   \
+  V(170, ByteArray_uint16AtPut)                                                \
+  V(171, ByteArray_int16At)                                                    \
+  V(172, ByteArray_int16AtPut)                                                 \
+  V(173, ByteArray_uint32At)                                                   \
+  V(174, ByteArray_uint32AtPut)                                                \
+  V(175, ByteArray_int32At)                                                    \
+  V(176, ByteArray_int32AtPut)                                                 \
+  V(177, ByteArray_uint64At)                                                   \
+  V(178, ByteArray_uint64AtPut)                                                \
+  V(179, ByteArray_int64At)                                                    \
+  V(180, ByteArray_int64AtPut)                                                 \
+  V(181, ByteArray_float32At)                                                  \
+  V(182, ByteArray_float32AtPut)                                               \
+  V(183, ByteArray_float64At)                                                  \
+  V(184, ByteArray_float64AtPut)                                               \
+  V(185, ByteArray_fillFromTo)                                                 \
+  V(186, Posix_open)                                                           \
+  V(187, Posix_read)                                                           \
+  V(188, Posix_write)                                                          \
+  V(189, Posix_close)                                                          \
+  V(190, Posix_tcpListen)                                                      \
+  V(191, Posix_tcpConnect)                                                     \
+  V(192, Posix_unixListen)                                                     \
+  V(193, Posix_unixConnect)                                                    \
+  V(194, Posix_accept)                                                         \
+  V(195, Posix_socketError)                                                    \
+  V(196, Posix_localPort)                                                      \
+  V(197, Posix_errorString)                                                    \
+  V(198, MappedBytes_map)                                                      \
+  V(199, MappedBytes_unmap)                                                    \
   V(200, quickReturnSelf)                                                      \
+  V(201, MappedBytes_size)                                                     \
+  V(202, MappedBytes_at)                                                       \
+  V(203, MappedBytes_copyFromTo)                                               \
+  V(204, MappedBytes_indexOf)                                                  \
+  V(205, takeFinalizationQueue)                                                \
+  V(206, MessageLoop_scheduleTimer)                                            \
+  V(207, MessageLoop_cancelTimer)                                              \
+  V(208, MessageLoop_takeExpiredTimers)                                        \
+  V(209, Platform_numberOfProcessors)                                          \
+  V(210, Bytes_contentHash)                                                    \
+  V(211, Map_scan)                                                             \
+  V(212, Set_scan)                                                             \
+  V(213, IdentityMap_scan)                                                     \
+  V(214, ByteArray_appendUnsigned)                                             \
+  V(215, ByteArray_appendBytes)                                                \
+  V(216, ByteArray_freezeAsByteArray)                                          \
+  V(217, ByteArray_freezeAsString)                                             \
+  V(218, takeMemoryPressure)                                                   \
+  V(219, gcStatistics)                                                         \
+  V(220, Posix_unlink)                                                         \
+  V(221, renameFile)                                                           \
+  V(222, setHeapLimits)                                                        \
+  V(223, Posix_startTransfers)                                                 \
 
 
 #define DEFINE_PRIMITIVE(name)                                                 \
@@ -307,8 +378,9 @@ const bool kFailure = false;
   RETURN(LargeInteger::Reduce(large_integer, H));                              \
 
 #define RETURN_FLOAT(raw_float)                                                \
+  double float_value = (raw_float);  /* Read operands before allocating. */    \
   Float64* result = H->AllocateFloat64();                                      \
-  result->set_value(raw_float);                                                \
+  result->set_value(float_value);                                              \
   RETURN(result);                                                              \
 
 #define RETURN_BOOL(raw_bool)                                                  \
@@ -1378,6 +1450,273 @@ DEFINE_PRIMITIVE(ByteArray_copyFromTo) {
 }
 
 
+// The multi-byte accessors take the 1-based index of the first byte and an
+// optional bigEndian: flag. Without the flag they are little-endian.
+static uint8_t* ByteArrayAddress(intptr_t num_args, intptr_t fixed_args,
+                                 intptr_t width, Interpreter* I,
+                                 bool* big_endian) {
+  if (num_args == fixed_args) {
+    *big_endian = false;
+  } else {
+    ASSERT(num_args == fixed_args + 1);
+    Object* flag = I->Stack(0);
+    if (flag == I->true_obj()) {
+      *big_endian = true;
+    } else if (flag == I->false_obj()) {
+      *big_endian = false;
+    } else {
+      return NULL;
+    }
+  }
+  ByteArray* array = static_cast<ByteArray*>(I->Stack(num_args));
+  ASSERT(array->IsByteArray());
+  Object* index = I->Stack(num_args - 1);
+  if (!index->IsSmallInteger()) {
+    return NULL;
+  }
+  intptr_t offset = static_cast<SmallInteger*>(index)->value() - 1;
+  if ((offset < 0) || (offset > array->Size() - width)) {
+    return NULL;
+  }
+  return array->element_addr(offset);
+}
+
+
+// Hosts are little-endian, so only big-endian accesses swap.
+static inline uint16_t Load16(const uint8_t* address, bool big_endian) {
+  uint16_t value;
+  memcpy(&value, address, sizeof(value));
+  return big_endian ? Utils::ByteSwap16(value) : value;
+}
+
+
+static inline uint32_t Load32(const uint8_t* address, bool big_endian) {
+  uint32_t value;
+  memcpy(&value, address, sizeof(value));
+  return big_endian ? Utils::ByteSwap32(value) : value;
+}
+
+
+static inline uint64_t Load64(const uint8_t* address, bool big_endian) {
+  uint64_t value;
+  memcpy(&value, address, sizeof(value));
+  return big_endian ? Utils::ByteSwap64(value) : value;
+}
+
+
+static inline void Store16(uint8_t* address, uint16_t value,
+                           bool big_endian) {
+  if (big_endian) value = Utils::ByteSwap16(value);
+  memcpy(address, &value, sizeof(value));
+}
+
+
+static inline void Store32(uint8_t* address, uint32_t value,
+                           bool big_endian) {
+  if (big_endian) value = Utils::ByteSwap32(value);
+  memcpy(address, &value, sizeof(value));
+}
+
+
+static inline void Store64(uint8_t* address, uint64_t value,
+                           bool big_endian) {
+  if (big_endian) value = Utils::ByteSwap64(value);
+  memcpy(address, &value, sizeof(value));
+}
+
+
+#define BYTE_ARRAY_ADDRESS(fixed_args, width)                                  \
+  bool big_endian;                                                             \
+  uint8_t* address =                                                           \
+      ByteArrayAddress(num_args, fixed_args, width, I, &big_endian);           \
+  if (address == NULL) {                                                       \
+    return kFailure;                                                           \
+  }                                                                            \
+
+
+DEFINE_PRIMITIVE(ByteArray_uint16At) {
+  BYTE_ARRAY_ADDRESS(1, 2);
+  RETURN_SMI(Load16(address, big_endian));
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_uint16AtPut) {
+  BYTE_ARRAY_ADDRESS(2, 2);
+  SMI_ARGUMENT(value, num_args - 2);
+  if ((value < 0) || (value > 0xFFFF)) {
+    return kFailure;
+  }
+  Store16(address, static_cast<uint16_t>(value), big_endian);
+  RETURN(I->Stack(num_args - 2));
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_int16At) {
+  BYTE_ARRAY_ADDRESS(1, 2);
+  RETURN_SMI(static_cast<int16_t>(Load16(address, big_endian)));
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_int16AtPut) {
+  BYTE_ARRAY_ADDRESS(2, 2);
+  SMI_ARGUMENT(value, num_args - 2);
+  if ((value < -0x8000) || (value > 0x7FFF)) {
+    return kFailure;
+  }
+  Store16(address, static_cast<uint16_t>(value), big_endian);
+  RETURN(I->Stack(num_args - 2));
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_uint32At) {
+  BYTE_ARRAY_ADDRESS(1, 4);
+  int64_t value = Load32(address, big_endian);
+  RETURN_MINT(value);
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_uint32AtPut) {
+  BYTE_ARRAY_ADDRESS(2, 4);
+  MINT_ARGUMENT(value, num_args - 2);
+  if ((value < 0) || (value > PSOUP_INT64_C(0xFFFFFFFF))) {
+    return kFailure;
+  }
+  Store32(address, static_cast<uint32_t>(value), big_endian);
+  RETURN(I->Stack(num_args - 2));
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_int32At) {
+  BYTE_ARRAY_ADDRESS(1, 4);
+  int64_t value = static_cast<int32_t>(Load32(address, big_endian));
+  RETURN_MINT(value);
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_int32AtPut) {
+  BYTE_ARRAY_ADDRESS(2, 4);
+  MINT_ARGUMENT(value, num_args - 2);
+  if ((value < kMinInt32) || (value > kMaxInt32)) {
+    return kFailure;
+  }
+  Store32(address, static_cast<uint32_t>(value), big_endian);
+  RETURN(I->Stack(num_args - 2));
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_uint64At) {
+  BYTE_ARRAY_ADDRESS(1, 8);
+  uint64_t value = Load64(address, big_endian);
+  if (value > static_cast<uint64_t>(kMaxInt64)) {
+    RETURN(LargeInteger::FromUint64(value, H));  // SAFEPOINT
+  }
+  int64_t signed_value = static_cast<int64_t>(value);
+  RETURN_MINT(signed_value);
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_uint64AtPut) {
+  BYTE_ARRAY_ADDRESS(2, 8);
+  Object* argument = I->Stack(num_args - 2);
+  uint64_t value;
+  if (argument->IsSmallInteger() || argument->IsMediumInteger()) {
+    int64_t signed_value = MINT_VALUE(argument);
+    if (signed_value < 0) {
+      return kFailure;
+    }
+    value = static_cast<uint64_t>(signed_value);
+  } else if (argument->IsLargeInteger()) {
+    if (!LargeInteger::ToUint64(static_cast<LargeInteger*>(argument),
+                                &value)) {
+      return kFailure;
+    }
+  } else {
+    return kFailure;
+  }
+  Store64(address, value, big_endian);
+  RETURN(argument);
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_int64At) {
+  BYTE_ARRAY_ADDRESS(1, 8);
+  int64_t value = static_cast<int64_t>(Load64(address, big_endian));
+  RETURN_MINT(value);
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_int64AtPut) {
+  BYTE_ARRAY_ADDRESS(2, 8);
+  MINT_ARGUMENT(value, num_args - 2);
+  Store64(address, static_cast<uint64_t>(value), big_endian);
+  RETURN(I->Stack(num_args - 2));
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_float32At) {
+  BYTE_ARRAY_ADDRESS(1, 4);
+  uint32_t bits = Load32(address, big_endian);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  RETURN_FLOAT(static_cast<double>(value));
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_float32AtPut) {
+  BYTE_ARRAY_ADDRESS(2, 4);
+  FLOAT_ARGUMENT(value, num_args - 2);
+  float narrowed = static_cast<float>(value);
+  uint32_t bits;
+  memcpy(&bits, &narrowed, sizeof(bits));
+  Store32(address, bits, big_endian);
+  RETURN(I->Stack(num_args - 2));
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_float64At) {
+  BYTE_ARRAY_ADDRESS(1, 8);
+  uint64_t bits = Load64(address, big_endian);
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  RETURN_FLOAT(value);
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_float64AtPut) {
+  BYTE_ARRAY_ADDRESS(2, 8);
+  FLOAT_ARGUMENT(value, num_args - 2);
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  Store64(address, bits, big_endian);
+  RETURN(I->Stack(num_args - 2));
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_fillFromTo) {
+  ASSERT(num_args == 3);
+  ByteArray* receiver = static_cast<ByteArray*>(I->Stack(3));
+  ASSERT(receiver->IsByteArray());
+  SMI_ARGUMENT(value, 2);
+  SMI_ARGUMENT(start, 1);
+  SMI_ARGUMENT(stop, 0);
+  if ((value < 0) || (value > 255)) {
+    return kFailure;
+  }
+  if (start <= 0) {
+    return kFailure;
+  }
+  if (stop < start) {
+    // Empty fill.
+    RETURN_SELF();
+  }
+  if (stop > receiver->Size()) {
+    return kFailure;
+  }
+  memset(receiver->element_addr(start - 1), value, stop - start + 1);
+  RETURN_SELF();
+}
+
+
 DEFINE_PRIMITIVE(ByteArray_replaceFromToWithStartingAt) {
   ASSERT(num_args == 4);
   ByteArray* receiver = static_cast<ByteArray*>(I->Stack(4));
@@ -1653,6 +1992,15 @@ DEFINE_PRIMITIVE(Activation_tempSizePut) {
 }
 
 
+DEFINE_PRIMITIVE(Activation_nextMarkedSenderUpTo) {
+  ASSERT(num_args == 1);
+  Activation* activation = static_cast<Activation*>(I->Stack(1));
+  ASSERT(activation->IsActivation());
+  Object* limit = I->Stack(0);
+  RETURN(I->ActivationNextMarkedSender(activation, limit));  // SAFEPOINT
+}
+
+
 DEFINE_PRIMITIVE(Activation_class_new) {
   ASSERT(num_args == 0);
   Activation* result = H->AllocateActivation();  // SAFEPOINT
@@ -1816,34 +2164,39 @@ DEFINE_PRIMITIVE(Object_identical) {
 }
 
 
-DEFINE_PRIMITIVE(Object_identityHash) {
-  ASSERT(num_args == 0 || num_args == 1);
-  Object* receiver = I->Stack(0);
+static intptr_t IdentityHash(Object* object, Isolate* isolate) {
   intptr_t hash;
-  if (receiver->IsSmallInteger()) {
-    hash = static_cast<SmallInteger*>(receiver)->value();
+  if (object->IsSmallInteger()) {
+    hash = static_cast<SmallInteger*>(object)->value();
     if (hash == 0) {
       hash = 1;
     }
-  } else if (receiver->IsMediumInteger()) {
-    hash = static_cast<MediumInteger*>(receiver)->value();
+  } else if (object->IsMediumInteger()) {
+    hash = static_cast<MediumInteger*>(object)->value();
     hash &= SmallInteger::kMaxValue;
     if (hash == 0) {
       hash = 1;
     }
-  } else if (receiver->IsString()) {
-    static_cast<String*>(receiver)->EnsureHash(I->isolate());
-    hash = static_cast<String*>(receiver)->header_hash();
+  } else if (object->IsString()) {
+    static_cast<String*>(object)->EnsureHash(isolate);
+    hash = static_cast<String*>(object)->header_hash();
   } else {
-    hash = static_cast<HeapObject*>(receiver)->header_hash();
+    hash = static_cast<HeapObject*>(object)->header_hash();
     if (hash == 0) {
-      hash = I->isolate()->random().NextUInt64() & SmallInteger::kMaxValue;
+      hash = isolate->random().NextUInt64() & SmallInteger::kMaxValue;
       if (hash == 0) {
         hash = 1;
       }
-      static_cast<HeapObject*>(receiver)->set_header_hash(hash);
+      static_cast<HeapObject*>(object)->set_header_hash(hash);
     }
   }
+  return hash;
+}
+
+
+DEFINE_PRIMITIVE(Object_identityHash) {
+  ASSERT(num_args == 0 || num_args == 1);
+  intptr_t hash = IdentityHash(I->Stack(0), I->isolate());
   RETURN_SMI(hash);
 }
 
@@ -1995,6 +2348,109 @@ DEFINE_PRIMITIVE(Behavior_allInstances) {
 }
 
 
+DEFINE_PRIMITIVE(takeFinalizationQueue) {
+  ASSERT(num_args == 0);
+  Object* result = H->TakeFinalizationQueue();  // SAFEPOINT
+  RETURN(result);
+}
+
+
+DEFINE_PRIMITIVE(takeMemoryPressure) {
+  ASSERT(num_args == 0);
+  if (!H->TakeMemoryPressure()) {
+    RETURN(nil);
+  }
+  int64_t size = H->Size();
+  RETURN_MINT(size);
+}
+
+
+DEFINE_PRIMITIVE(gcStatistics) {
+  ASSERT(num_args == 0);
+  int64_t stats[5];
+  stats[0] = H->scavenge_count();
+  stats[1] = H->scavenge_time() / kNanosecondsPerMicrosecond;
+  stats[2] = H->mark_sweep_count();
+  stats[3] = H->mark_sweep_time() / kNanosecondsPerMicrosecond;
+  stats[4] = H->TakeLongestPause() / kNanosecondsPerMicrosecond;
+  Array* result = H->AllocateArray(5);  // SAFEPOINT
+  for (intptr_t i = 0; i < 5; i++) {
+    ASSERT(SmallInteger::IsSmiValue(stats[i]));
+    result->set_element(i, SmallInteger::New(stats[i]), kNoBarrier);
+  }
+  RETURN(result);
+}
+
+
+DEFINE_PRIMITIVE(setHeapLimits) {
+  ASSERT(num_args == 2);
+  SMI_ARGUMENT(soft_limit, 1);
+  SMI_ARGUMENT(hard_limit, 0);
+  if ((soft_limit < 0) || (hard_limit < 0)) {
+    return kFailure;
+  }
+  H->ChangeLimits(soft_limit, hard_limit);
+  RETURN_SELF();
+}
+
+
+DEFINE_PRIMITIVE(heapCensus) {
+  ASSERT(num_args == 0);
+  intptr_t num_cids = H->class_table_size();
+  intptr_t* counts =
+      reinterpret_cast<intptr_t*>(calloc(num_cids, sizeof(intptr_t)));
+  intptr_t* sizes =
+      reinterpret_cast<intptr_t*>(calloc(num_cids, sizeof(intptr_t)));
+  H->Census(counts, sizes);
+
+  intptr_t num_classes = 0;
+  for (intptr_t cid = kFirstLegalCid; cid < num_cids; cid++) {
+    if (counts[cid] != 0) {
+      num_classes++;
+    }
+  }
+
+  // Triples of class, number of instances and bytes.
+  Array* result = H->AllocateArray(3 * num_classes);  // SAFEPOINT
+  intptr_t index = 0;
+  for (intptr_t cid = kFirstLegalCid; cid < num_cids; cid++) {
+    if (counts[cid] == 0) {
+      continue;
+    }
+    Object* cls = H->ClassAt(cid);
+    if (cls->IsSmallInteger()) {
+      // Released by a GC during the allocation above.
+      cls = nil;
+    }
+    result->set_element(index++, cls);
+    result->set_element(index++, SmallInteger::New(counts[cid]), kNoBarrier);
+    result->set_element(index++, SmallInteger::New(sizes[cid]), kNoBarrier);
+  }
+  free(counts);
+  free(sizes);
+  RETURN(result);
+}
+
+
+DEFINE_PRIMITIVE(heapDump) {
+  ASSERT(num_args == 1);
+  String* filename = static_cast<String*>(I->Stack(0));
+  if (!filename->IsString()) {
+    return kFailure;
+  }
+
+  char* raw_filename = reinterpret_cast<char*>(malloc(filename->Size() + 1));
+  memcpy(raw_filename, filename->element_addr(0), filename->Size());
+  raw_filename[filename->Size()] = 0;
+  bool success = H->DumpGraph(raw_filename);
+  free(raw_filename);
+  if (!success) {
+    return kFailure;
+  }
+  RETURN_SELF();
+}
+
+
 DEFINE_PRIMITIVE(Array_elementsForwardIdentity) {
   ASSERT(num_args == 2);
   Array* left = static_cast<Array*>(I->Stack(1));
@@ -2017,6 +2473,16 @@ DEFINE_PRIMITIVE(Platform_operatingSystem) {
 }
 
 
+DEFINE_PRIMITIVE(Platform_numberOfProcessors) {
+  ASSERT(num_args == 0);
+  intptr_t count = OS::NumberOfAvailableProcessors();
+  if (count < 1) {
+    count = 1;
+  }
+  RETURN_SMI(count);
+}
+
+
 DEFINE_PRIMITIVE(Time_monotonicNanos) {
   ASSERT(num_args == 0);
   int64_t now = OS::CurrentMonotonicNanos();
@@ -2276,6 +2742,35 @@ DEFINE_PRIMITIVE(Bytes_endsWith) {
 }
 
 
+// Answers the 0-based index of the first occurrence of pattern in
+// data[start, length), or -1. Candidates are found with memchr on the first
+// byte of the pattern, which is much faster than comparing at every position.
+static intptr_t IndexOfBytes(const uint8_t* data, intptr_t length,
+                             const uint8_t* pattern, intptr_t pattern_length,
+                             intptr_t start) {
+  if (pattern_length > length) {
+    return -1;
+  }
+  if (pattern_length == 0) {
+    return start <= length - pattern_length ? start : -1;
+  }
+  intptr_t limit = length - pattern_length;
+  while (start <= limit) {
+    const uint8_t* candidate = reinterpret_cast<const uint8_t*>(
+        memchr(data + start, pattern[0], limit - start + 1));
+    if (candidate == NULL) {
+      return -1;
+    }
+    start = candidate - data;
+    if (memcmp(candidate + 1, pattern + 1, pattern_length - 1) == 0) {
+      return start;
+    }
+    start++;
+  }
+  return -1;
+}
+
+
 DEFINE_PRIMITIVE(Bytes_indexOf) {
   ASSERT(num_args == 2);
 
@@ -2302,24 +2797,10 @@ DEFINE_PRIMITIVE(Bytes_indexOf) {
     return kFailure;
   }
 
-  if (substring_length > string_length) {
-    RETURN_SMI(static_cast<intptr_t>(0));
-  }
-
-  intptr_t limit = string_length - substring_length;
-  for (intptr_t start = start_index; start <= limit; start++) {
-    bool found = true;
-    for (intptr_t i = 0; i < substring_length; i++) {
-      if (string->element(start + i) != substring->element(i)) {
-        found = false;
-        break;
-      }
-    }
-    if (found) {
-      RETURN_SMI(start + 1);
-    }
-  }
-  RETURN_SMI(static_cast<intptr_t>(0));
+  intptr_t index = IndexOfBytes(string->element_addr(0), string_length,
+                                substring->element_addr(0), substring_length,
+                                start_index);
+  RETURN_SMI(index + 1);
 }
 
 
@@ -2553,6 +3034,31 @@ DEFINE_PRIMITIVE(writeBytesToFile) {
 }
 
 
+DEFINE_PRIMITIVE(renameFile) {
+  ASSERT(num_args == 2);
+  String* from = static_cast<String*>(I->Stack(1));
+  String* to = static_cast<String*>(I->Stack(0));
+  if (!from->IsString() || !to->IsString()) {
+    return kFailure;
+  }
+
+  char* raw_from = reinterpret_cast<char*>(malloc(from->Size() + 1));
+  memcpy(raw_from, from->element_addr(0), from->Size());
+  raw_from[from->Size()] = 0;
+  char* raw_to = reinterpret_cast<char*>(malloc(to->Size() + 1));
+  memcpy(raw_to, to->element_addr(0), to->Size());
+  raw_to[to->Size()] = 0;
+  int result = rename(raw_from, raw_to);
+  free(raw_from);
+  free(raw_to);
+  if (result != 0) {
+    return kFailure;
+  }
+
+  RETURN_SELF();
+}
+
+
 DEFINE_PRIMITIVE(readFileAsBytes) {
   ASSERT(num_args == 1);
   String* filename = static_cast<String*>(I->Stack(0));
@@ -2565,7 +3071,8 @@ DEFINE_PRIMITIVE(readFileAsBytes) {
   raw_filename[filename->Size()] = 0;
   FILE* f = fopen(raw_filename, "rb");
   if (f == NULL) {
-    FATAL1("Failed to stat '%s'\n", raw_filename);
+    free(raw_filename);
+    return kFailure;
   }
   struct stat st;
   if (fstat(fileno(f), &st) != 0) {
@@ -2592,42 +3099,289 @@ DEFINE_PRIMITIVE(readFileAsBytes) {
 }
 
 
-DEFINE_PRIMITIVE(Double_class_parse) {
+// Unlike String_hash, not salted per isolate, so the result can name things
+// that outlive the process.
+DEFINE_PRIMITIVE(Bytes_contentHash) {
   ASSERT(num_args == 1);
-  String* string = static_cast<String*>(I->Stack(0));
-  if (!string->IsString()) {
+  Bytes* bytes = static_cast<Bytes*>(I->Stack(0));
+  if (!bytes->IsBytes()) {
     return kFailure;
   }
-  double raw_result;
-  const char* cstr = reinterpret_cast<const char*>(string->element_addr(0));
-  intptr_t length = string->Size();
-  if (CStringToDouble(cstr, length, &raw_result)) {
-    RETURN_FLOAT(raw_result);
+  // 64-bit FNV-1a.
+  uint64_t h = 14695981039346656037ULL;
+  intptr_t length = bytes->Size();
+  for (intptr_t i = 0; i < length; i++) {
+    h = (h ^ bytes->element(i)) * 1099511628211ULL;
   }
-  return kFailure;
-}
-
-
-DEFINE_PRIMITIVE(currentActivation) {
-  ASSERT(num_args == 0);
-  RETURN(I->CurrentActivation());  // SAFEPOINT
+  int64_t hash = static_cast<int64_t>(h >> 1);
+  RETURN_MINT(hash);
 }
 
 
-DEFINE_PRIMITIVE(Behavior_adoptInstance) {
-  ASSERT(num_args == 2);
-  Behavior* new_cls = static_cast<Behavior*>(I->Stack(1));
-  HeapObject* instance = static_cast<HeapObject*>(I->Stack(0));
-  Behavior* old_cls = instance->Klass(H);
-
-  ASSERT(old_cls->cid() >= kFirstRegularObjectCid);
-  ASSERT(old_cls->format() == new_cls->format());
-
-  SmallInteger* id = new_cls->id();
-  if (id == nil) {
-    id = SmallInteger::New(H->AllocateClassId());  // SAFEPOINT
-    new_cls = static_cast<Behavior*>(I->Stack(1));
-    instance = static_cast<HeapObject*>(I->Stack(0));
+// Answers whether key = entry, for the keys whose = the VM knows. Sets
+// *known to false when the answer depends on Newspeak code.
+static bool KnownEquals(Object* key, Object* entry, Isolate* isolate,
+                        bool* known) {
+  *known = true;
+  if (key == entry) {
+    return true;
+  }
+  if (key->IsSmallInteger()) {
+    if (entry->IsSmallInteger()) {
+      return false;
+    }
+    if (entry->IsFloat64()) {
+      *known = false;  // SmallInteger>>= compares numerically.
+    }
+    return false;
+  }
+  ASSERT(key->IsString());
+  if (!entry->IsString()) {
+    return false;
+  }
+  String* left = static_cast<String*>(key);
+  String* right = static_cast<String*>(entry);
+  if (left->size() != right->size()) {
+    return false;
+  }
+  if (left->EnsureHash(isolate) != right->EnsureHash(isolate)) {
+    return false;
+  }
+  intptr_t length = left->Size();
+  for (intptr_t i = 0; i < length; i++) {
+    if (left->element(i) != right->element(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+// The probe loops of Map>>scanFor: and Set>>scanFor:, for SmallInteger and
+// String keys. Answers the 1-based index of the key, or of the empty slot
+// (which holds the table itself) where it belongs. Any other key, or a full
+// table, fails to the Newspeak loop, which sends hash and = and signals
+// errorNoFreeSpace.
+static bool ScanHashedTable(Interpreter* I, intptr_t num_args,
+                            intptr_t stride) {
+  ASSERT(num_args == 2);
+  Array* table = static_cast<Array*>(I->Stack(1));
+  Object* key = I->Stack(0);
+  if (!table->IsArray() || (table->Size() == 0)) {
+    return kFailure;
+  }
+  intptr_t hash;
+  if (key->IsSmallInteger()) {
+    hash = static_cast<SmallInteger*>(key)->value();  // Integer>>hash
+  } else if (key->IsString()) {
+    hash = static_cast<String*>(key)->EnsureHash(I->isolate())->value();
+  } else {
+    return kFailure;
+  }
+
+  intptr_t size = table->Size();
+  if (stride == 2) {
+    hash |= 1;  // Keys are at odd indices.
+  }
+  intptr_t start = hash % size;
+  if (start < 0) {
+    start += size;
+  }
+  if (stride == 2) {
+    start -= 1;
+  }
+  intptr_t index = start;
+  do {
+    Object* entry = table->element(index);
+    if (entry == table) {
+      intptr_t result_index = index + 1;
+      RETURN_SMI(result_index);
+    }
+    bool known;
+    if (KnownEquals(key, entry, I->isolate(), &known)) {
+      intptr_t result_index = index + 1;
+      RETURN_SMI(result_index);
+    }
+    if (!known) {
+      return kFailure;
+    }
+    index += stride;
+    if (index >= size) {
+      index -= size;
+    }
+  } while (index != start);
+  return kFailure;
+}
+
+
+DEFINE_PRIMITIVE(Map_scan) {
+  return ScanHashedTable(I, num_args, 2);
+}
+
+
+DEFINE_PRIMITIVE(Set_scan) {
+  return ScanHashedTable(I, num_args, 1);
+}
+
+
+// The probe loop of PrimordialFuel's IdentityMap, whose table size is a power
+// of two. Answers the 1-based index of the key or of the empty slot.
+DEFINE_PRIMITIVE(IdentityMap_scan) {
+  ASSERT(num_args == 2);
+  Array* table = static_cast<Array*>(I->Stack(1));
+  Object* key = I->Stack(0);
+  if (!table->IsArray() || (table->Size() < 2) ||
+      !Utils::IsPowerOfTwo(table->Size())) {
+    return kFailure;
+  }
+  intptr_t mask = table->Size() - 2;
+  intptr_t index = IdentityHash(key, I->isolate()) & mask;
+  for (intptr_t probes = table->Size() >> 1; probes > 0; probes--) {
+    Object* entry = table->element(index);
+    if ((entry == key) || (entry == table)) {
+      intptr_t result_index = index + 1;
+      RETURN_SMI(result_index);
+    }
+    index = (index + 2) & mask;
+  }
+  return kFailure;
+}
+
+
+// The appends write into a ByteArray used as a buffer, after its first
+// position bytes, and answer the new position. They fail when the buffer is
+// too small so that the caller can grow it and retry.
+DEFINE_PRIMITIVE(ByteArray_appendUnsigned) {
+  ASSERT(num_args == 3);
+  ByteArray* buffer = static_cast<ByteArray*>(I->Stack(2));
+  Object* position = I->Stack(1);
+  Object* value = I->Stack(0);
+  if (!buffer->IsByteArray() || !position->IsSmallInteger()) {
+    return kFailure;
+  }
+  int64_t raw_value;
+  if (value->IsSmallInteger()) {
+    raw_value = static_cast<SmallInteger*>(value)->value();
+  } else if (value->IsMediumInteger()) {
+    raw_value = static_cast<MediumInteger*>(value)->value();
+  } else {
+    return kFailure;
+  }
+  if (raw_value < 0) {
+    return kFailure;
+  }
+  intptr_t index = static_cast<SmallInteger*>(position)->value();
+  intptr_t length = 1;
+  for (uint64_t v = raw_value; v > 127; v >>= 7) {
+    length++;
+  }
+  if ((index < 0) || (index > buffer->Size() - length)) {
+    return kFailure;
+  }
+  // VictoryFuel's unsigned encoding: 7 bits per byte, least significant
+  // first, with the high bit marking the last byte.
+  uint64_t v = raw_value;
+  while (v > 127) {
+    buffer->set_element(index++, v & 127);
+    v >>= 7;
+  }
+  buffer->set_element(index++, v + 128);
+  RETURN_SMI(index);
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_appendBytes) {
+  ASSERT(num_args == 3);
+  ByteArray* buffer = static_cast<ByteArray*>(I->Stack(2));
+  Object* position = I->Stack(1);
+  Bytes* source = static_cast<Bytes*>(I->Stack(0));
+  if (!buffer->IsByteArray() || !position->IsSmallInteger() ||
+      !source->IsBytes()) {
+    return kFailure;
+  }
+  intptr_t index = static_cast<SmallInteger*>(position)->value();
+  intptr_t length = source->Size();
+  if ((index < 0) || (index > buffer->Size() - length)) {
+    return kFailure;
+  }
+  memmove(buffer->element_addr(index), source->element_addr(0), length);
+  intptr_t new_position = index + length;
+  RETURN_SMI(new_position);
+}
+
+
+// Answers the buffer itself, truncated to its first size bytes and with the
+// given class, without copying. The caller must drop its other references to
+// the buffer.
+static bool FreezeBuffer(intptr_t num_args, Heap* H, Interpreter* I,
+                         intptr_t cid) {
+  ASSERT(num_args == 2);
+  ByteArray* buffer = static_cast<ByteArray*>(I->Stack(1));
+  Object* size = I->Stack(0);
+  if (!buffer->IsByteArray() || !size->IsSmallInteger()) {
+    return kFailure;
+  }
+  intptr_t new_size = static_cast<SmallInteger*>(size)->value();
+  if ((new_size < 0) || (new_size > buffer->Size())) {
+    return kFailure;
+  }
+  // A String keeps its content hash where a ByteArray keeps its identity hash.
+  intptr_t hash = (cid == kByteArrayCid) ? buffer->header_hash() : 0;
+  intptr_t heap_size = AllocationSize(sizeof(ByteArray) + new_size);
+  H->Shrink(buffer, heap_size);
+  HeapObject::Initialize(buffer->Addr(), cid, heap_size);
+  buffer->set_header_hash(hash);
+  buffer->set_size(SmallInteger::New(new_size));
+  RETURN(buffer);
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_freezeAsByteArray) {
+  return FreezeBuffer(num_args, H, I, kByteArrayCid);
+}
+
+
+DEFINE_PRIMITIVE(ByteArray_freezeAsString) {
+  return FreezeBuffer(num_args, H, I, kStringCid);
+}
+
+
+DEFINE_PRIMITIVE(Double_class_parse) {
+  ASSERT(num_args == 1);
+  String* string = static_cast<String*>(I->Stack(0));
+  if (!string->IsString()) {
+    return kFailure;
+  }
+  double raw_result;
+  const char* cstr = reinterpret_cast<const char*>(string->element_addr(0));
+  intptr_t length = string->Size();
+  if (CStringToDouble(cstr, length, &raw_result)) {
+    RETURN_FLOAT(raw_result);
+  }
+  return kFailure;
+}
+
+
+DEFINE_PRIMITIVE(currentActivation) {
+  ASSERT(num_args == 0);
+  RETURN(I->CurrentActivation());  // SAFEPOINT
+}
+
+
+DEFINE_PRIMITIVE(Behavior_adoptInstance) {
+  ASSERT(num_args == 2);
+  Behavior* new_cls = static_cast<Behavior*>(I->Stack(1));
+  HeapObject* instance = static_cast<HeapObject*>(I->Stack(0));
+  Behavior* old_cls = instance->Klass(H);
+
+  ASSERT(old_cls->cid() >= kFirstRegularObjectCid);
+  ASSERT(old_cls->format() == new_cls->format());
+
+  SmallInteger* id = new_cls->id();
+  if (id == nil) {
+    id = SmallInteger::New(H->AllocateClassId());  // SAFEPOINT
+    new_cls = static_cast<Behavior*>(I->Stack(1));
+    instance = static_cast<HeapObject*>(I->Stack(0));
     new_cls->set_id(id);
     H->RegisterClass(id->value(), new_cls);
   }
@@ -2691,13 +3445,60 @@ DEFINE_PRIMITIVE(send) {
 DEFINE_PRIMITIVE(MessageLoop_finish) {
   ASSERT(num_args == 1);
   MINT_ARGUMENT(new_wakeup, 0);
-  I->isolate()->loop()->MessageEpilogue(new_wakeup);
+  MessageLoop* loop = I->isolate()->loop();
+  int64_t timer_wakeup = loop->timers()->NextWakeup();
+  if ((timer_wakeup != 0) &&
+      ((new_wakeup == 0) || (timer_wakeup < new_wakeup))) {
+    new_wakeup = timer_wakeup;
+  }
+  loop->MessageEpilogue(new_wakeup);
   I->Exit();
   UNREACHABLE();
   return kFailure;
 }
 
 
+DEFINE_PRIMITIVE(MessageLoop_scheduleTimer) {
+  ASSERT(num_args == 1);
+  SMI_ARGUMENT(milliseconds, 0);
+  if (milliseconds < 0) {
+    return kFailure;
+  }
+  int64_t deadline = OS::CurrentMonotonicNanos() +
+      static_cast<int64_t>(milliseconds) * kNanosecondsPerMillisecond;
+  intptr_t id = I->isolate()->loop()->timers()->Schedule(deadline);
+  if (id < 0) {
+    return kFailure;
+  }
+  RETURN_SMI(id);
+}
+
+
+DEFINE_PRIMITIVE(MessageLoop_cancelTimer) {
+  ASSERT(num_args == 1);
+  SMI_ARGUMENT(id, 0);
+  bool cancelled = I->isolate()->loop()->timers()->Cancel(id);
+  RETURN_BOOL(cancelled);
+}
+
+
+DEFINE_PRIMITIVE(MessageLoop_takeExpiredTimers) {
+  ASSERT(num_args == 0);
+  TimerWheel* timers = I->isolate()->loop()->timers();
+  timers->Advance(OS::CurrentMonotonicNanos());
+  intptr_t count = timers->expired_count();
+  if (count == 0) {
+    RETURN(nil);
+  }
+  Array* result = H->AllocateArray(count);  // SAFEPOINT
+  for (intptr_t i = 0; i < count; i++) {
+    result->set_element(i, SmallInteger::New(timers->TakeExpired()),
+                        kNoBarrier);
+  }
+  RETURN(result);
+}
+
+
 DEFINE_PRIMITIVE(doPrimitiveWithArgs) {
   ASSERT(num_args == 3);
   SmallInteger* primitive_index = static_cast<SmallInteger*>(I->Stack(2));
@@ -3051,6 +3852,582 @@ DEFINE_PRIMITIVE(ZXVmo_write) {
 #endif
 }
 
+
+static char* NewCString(Bytes* string) {
+  char* result = reinterpret_cast<char*>(malloc(string->Size() + 1));
+  memcpy(result, string->element_addr(0), string->Size());
+  result[string->Size()] = 0;
+  return result;
+}
+
+
+// Non-blocking file and socket descriptors for use with
+// MessageLoop::AwaitSignal. Failures answer the negated errno, and
+// operations that would block answer nil.
+#if defined(USING_POSIX_IO)
+static bool SetNonBlockingCloseOnExec(int fd) {
+  int flags = fcntl(fd, F_GETFL);
+  if ((flags == -1) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)) {
+    return false;
+  }
+  flags = fcntl(fd, F_GETFD);
+  if ((flags == -1) || (fcntl(fd, F_SETFD, flags | FD_CLOEXEC) == -1)) {
+    return false;
+  }
+  return true;
+}
+
+
+static bool WouldBlock(int error) {
+  return (error == EAGAIN) || (error == EWOULDBLOCK);
+}
+
+
+static int NewSocket(int domain) {
+  int fd = socket(domain, SOCK_STREAM, 0);
+  if (fd == -1) {
+    return -1;
+  }
+  if (!SetNonBlockingCloseOnExec(fd)) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    return -1;
+  }
+#if defined(SO_NOSIGPIPE)
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+  return fd;
+}
+
+
+// Only numeric addresses are accepted, so no lookup can block the isolate.
+static bool ParseAddress(String* host, intptr_t port,
+                         struct sockaddr_storage* address,
+                         socklen_t* length) {
+  if ((port < 0) || (port > 0xFFFF)) {
+    return false;
+  }
+  char* raw_host = NewCString(host);
+  memset(address, 0, sizeof(*address));
+  struct sockaddr_in* ipv4 = reinterpret_cast<struct sockaddr_in*>(address);
+  struct sockaddr_in6* ipv6 = reinterpret_cast<struct sockaddr_in6*>(address);
+  bool result = true;
+  if (inet_pton(AF_INET, raw_host, &ipv4->sin_addr) == 1) {
+    ipv4->sin_family = AF_INET;
+    ipv4->sin_port = htons(port);
+    *length = sizeof(*ipv4);
+  } else if (inet_pton(AF_INET6, raw_host, &ipv6->sin6_addr) == 1) {
+    ipv6->sin6_family = AF_INET6;
+    ipv6->sin6_port = htons(port);
+    *length = sizeof(*ipv6);
+  } else {
+    result = false;
+  }
+  free(raw_host);
+  return result;
+}
+
+
+static bool ParseUnixAddress(String* path, struct sockaddr_un* address) {
+  memset(address, 0, sizeof(*address));
+  if (static_cast<size_t>(path->Size()) >= sizeof(address->sun_path)) {
+    return false;
+  }
+  address->sun_family = AF_UNIX;
+  memcpy(address->sun_path, path->element_addr(0), path->Size());
+  return true;
+}
+
+
+static intptr_t Listen(int domain, const struct sockaddr* address,
+                       socklen_t length, intptr_t backlog) {
+  int fd = NewSocket(domain);
+  if (fd == -1) {
+    return -errno;
+  }
+  if (domain != AF_UNIX) {
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  }
+  if ((bind(fd, address, length) == -1) || (listen(fd, backlog) == -1)) {
+    int error = errno;
+    close(fd);
+    return -error;
+  }
+  return fd;
+}
+
+
+static intptr_t Connect(int domain, const struct sockaddr* address,
+                        socklen_t length) {
+  int fd = NewSocket(domain);
+  if (fd == -1) {
+    return -errno;
+  }
+  if (domain != AF_UNIX) {
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  }
+  // Completion is signalled by writability; see Posix_socketError.
+  if ((connect(fd, address, length) == -1) && (errno != EINPROGRESS)) {
+    int error = errno;
+    close(fd);
+    return -error;
+  }
+  return fd;
+}
+#endif  // defined(USING_POSIX_IO)
+
+
+DEFINE_PRIMITIVE(Posix_open) {
+#if !defined(USING_POSIX_IO)
+  return kFailure;
+#else
+  ASSERT(num_args == 2);
+  String* path = static_cast<String*>(I->Stack(1));
+  if (!path->IsString()) {
+    return kFailure;
+  }
+  SMI_ARGUMENT(mode, 0);
+  int flags;
+  switch (mode) {
+    case 0: flags = O_RDONLY; break;
+    case 1: flags = O_WRONLY | O_CREAT | O_TRUNC; break;
+    case 2: flags = O_WRONLY | O_CREAT | O_APPEND; break;
+    default: return kFailure;
+  }
+  char* raw_path = NewCString(path);
+  int fd = open(raw_path, flags | O_NONBLOCK | O_CLOEXEC, 0666);
+  int error = errno;
+  free(raw_path);
+  if (fd == -1) {
+    RETURN_SMI(-error);
+  }
+  RETURN_SMI(fd);
+#endif
+}
+
+
+DEFINE_PRIMITIVE(Posix_read) {
+#if !defined(USING_POSIX_IO)
+  return kFailure;
+#else
+  ASSERT(num_args == 4);
+  SMI_ARGUMENT(fd, 3);
+  ByteArray* buffer = static_cast<ByteArray*>(I->Stack(2));
+  if (!buffer->IsByteArray()) {
+    return kFailure;
+  }
+  SMI_ARGUMENT(start, 1);
+  SMI_ARGUMENT(count, 0);
+  if ((start <= 0) || (count < 0) || (start - 1 + count > buffer->Size())) {
+    return kFailure;
+  }
+  MessageLoop* loop = I->isolate()->loop();
+  if (loop->IsTransferring(fd)) {
+    intptr_t result = loop->Read(fd, buffer->element_addr(start - 1), count);
+    if (result == -EAGAIN) {
+      RETURN(nil);
+    }
+    RETURN_SMI(result);
+  }
+  ssize_t result = read(fd, buffer->element_addr(start - 1), count);
+  if (result == -1) {
+    if (WouldBlock(errno)) {
+      RETURN(nil);
+    }
+    RETURN_SMI(-errno);
+  }
+  RETURN_SMI(result);
+#endif
+}
+
+
+DEFINE_PRIMITIVE(Posix_write) {
+#if !defined(USING_POSIX_IO)
+  return kFailure;
+#else
+  ASSERT(num_args == 4);
+  SMI_ARGUMENT(fd, 3);
+  Bytes* buffer = static_cast<Bytes*>(I->Stack(2));
+  if (!buffer->IsBytes()) {
+    return kFailure;
+  }
+  SMI_ARGUMENT(start, 1);
+  SMI_ARGUMENT(count, 0);
+  if ((start <= 0) || (count < 0) || (start - 1 + count > buffer->Size())) {
+    return kFailure;
+  }
+  const uint8_t* data = buffer->element_addr(start - 1);
+  MessageLoop* loop = I->isolate()->loop();
+  if (loop->IsTransferring(fd)) {
+    intptr_t result = loop->Write(fd, data, count);
+    if (result == -EAGAIN) {
+      RETURN(nil);
+    }
+    RETURN_SMI(result);
+  }
+  ssize_t result;
+#if defined(MSG_NOSIGNAL)
+  // A peer that has gone away should produce EPIPE, not SIGPIPE.
+  result = send(fd, data, count, MSG_NOSIGNAL);
+  if ((result == -1) && (errno == ENOTSOCK)) {
+    result = write(fd, data, count);
+  }
+#else
+  result = write(fd, data, count);
+#endif
+  if (result == -1) {
+    if (WouldBlock(errno)) {
+      RETURN(nil);
+    }
+    RETURN_SMI(-errno);
+  }
+  RETURN_SMI(result);
+#endif
+}
+
+
+DEFINE_PRIMITIVE(Posix_close) {
+#if !defined(USING_POSIX_IO)
+  return kFailure;
+#else
+  ASSERT(num_args == 1);
+  SMI_ARGUMENT(fd, 0);
+  MessageLoop* loop = I->isolate()->loop();
+  if (loop->IsTransferring(fd)) {
+    intptr_t result = loop->CloseTransfers(fd);
+    RETURN_SMI(result);
+  }
+  if (close(fd) == -1) {
+    RETURN_SMI(-errno);
+  }
+  RETURN_SMI(0);
+#endif
+}
+
+
+DEFINE_PRIMITIVE(Posix_startTransfers) {
+#if !defined(USING_POSIX_IO)
+  return kFailure;
+#else
+  ASSERT(num_args == 1);
+  SMI_ARGUMENT(fd, 0);
+  RETURN_BOOL(I->isolate()->loop()->StartTransfers(fd));
+#endif
+}
+
+
+DEFINE_PRIMITIVE(Posix_unlink) {
+#if !defined(USING_POSIX_IO)
+  return kFailure;
+#else
+  ASSERT(num_args == 1);
+  String* path = static_cast<String*>(I->Stack(0));
+  if (!path->IsString()) {
+    return kFailure;
+  }
+  char* raw_path = NewCString(path);
+  int result = unlink(raw_path);
+  int error = errno;
+  free(raw_path);
+  if (result == -1) {
+    RETURN_SMI(-error);
+  }
+  RETURN_SMI(0);
+#endif
+}
+
+
+DEFINE_PRIMITIVE(Posix_tcpListen) {
+#if !defined(USING_POSIX_IO)
+  return kFailure;
+#else
+  ASSERT(num_args == 3);
+  String* host = static_cast<String*>(I->Stack(2));
+  if (!host->IsString()) {
+    return kFailure;
+  }
+  SMI_ARGUMENT(port, 1);
+  SMI_ARGUMENT(backlog, 0);
+  struct sockaddr_storage address;
+  socklen_t length;
+  if (!ParseAddress(host, port, &address, &length)) {
+    return kFailure;
+  }
+  intptr_t fd = Listen(address.ss_family,
+                       reinterpret_cast<struct sockaddr*>(&address), length,
+                       backlog);
+  RETURN_SMI(fd);
+#endif
+}
+
+
+DEFINE_PRIMITIVE(Posix_tcpConnect) {
+#if !defined(USING_POSIX_IO)
+  return kFailure;
+#else
+  ASSERT(num_args == 2);
+  String* host = static_cast<String*>(I->Stack(1));
+  if (!host->IsString()) {
+    return kFailure;
+  }
+  SMI_ARGUMENT(port, 0);
+  struct sockaddr_storage address;
+  socklen_t length;
+  if (!ParseAddress(host, port, &address, &length)) {
+    return kFailure;
+  }
+  intptr_t fd = Connect(address.ss_family,
+                        reinterpret_cast<struct sockaddr*>(&address), length);
+  RETURN_SMI(fd);
+#endif
+}
+
+
+DEFINE_PRIMITIVE(Posix_unixListen) {
+#if !defined(USING_POSIX_IO)
+  return kFailure;
+#else
+  ASSERT(num_args == 2);
+  String* path = static_cast<String*>(I->Stack(1));
+  if (!path->IsString()) {
+    return kFailure;
+  }
+  SMI_ARGUMENT(backlog, 0);
+  struct sockaddr_un address;
+  if (!ParseUnixAddress(path, &address)) {
+    return kFailure;
+  }
+  intptr_t fd = Listen(AF_UNIX, reinterpret_cast<struct sockaddr*>(&address),
+                       sizeof(address), backlog);
+  RETURN_SMI(fd);
+#endif
+}
+
+
+DEFINE_PRIMITIVE(Posix_unixConnect) {
+#if !defined(USING_POSIX_IO)
+  return kFailure;
+#else
+  ASSERT(num_args == 1);
+  String* path = static_cast<String*>(I->Stack(0));
+  if (!path->IsString()) {
+    return kFailure;
+  }
+  struct sockaddr_un address;
+  if (!ParseUnixAddress(path, &address)) {
+    return kFailure;
+  }
+  intptr_t fd = Connect(AF_UNIX, reinterpret_cast<struct sockaddr*>(&address),
+                        sizeof(address));
+  RETURN_SMI(fd);
+#endif
+}
+
+
+DEFINE_PRIMITIVE(Posix_accept) {
+#if !defined(USING_POSIX_IO)
+  return kFailure;
+#else
+  ASSERT(num_args == 1);
+  SMI_ARGUMENT(fd, 0);
+  struct sockaddr_storage address;
+  socklen_t length = sizeof(address);
+  int connection = accept(fd, reinterpret_cast<struct sockaddr*>(&address),
+                          &length);
+  if (connection == -1) {
+    if (WouldBlock(errno)) {
+      RETURN(nil);
+    }
+    RETURN_SMI(-errno);
+  }
+  if (!SetNonBlockingCloseOnExec(connection)) {
+    int error = errno;
+    close(connection);
+    RETURN_SMI(-error);
+  }
+  if (address.ss_family != AF_UNIX) {
+    int on = 1;
+    setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  }
+#if defined(SO_NOSIGPIPE)
+  int on = 1;
+  setsockopt(connection, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+  RETURN_SMI(connection);
+#endif
+}
+
+
+DEFINE_PRIMITIVE(Posix_socketError) {
+#if !defined(USING_POSIX_IO)
+  return kFailure;
+#else
+  ASSERT(num_args == 1);
+  SMI_ARGUMENT(fd, 0);
+  int error = 0;
+  socklen_t length = sizeof(error);
+  if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == -1) {
+    RETURN_SMI(-errno);
+  }
+  RETURN_SMI(-error);
+#endif
+}
+
+
+DEFINE_PRIMITIVE(Posix_localPort) {
+#if !defined(USING_POSIX_IO)
+  return kFailure;
+#else
+  ASSERT(num_args == 1);
+  SMI_ARGUMENT(fd, 0);
+  struct sockaddr_storage address;
+  socklen_t length = sizeof(address);
+  if (getsockname(fd, reinterpret_cast<struct sockaddr*>(&address),
+                  &length) == -1) {
+    RETURN_SMI(-errno);
+  }
+  if (address.ss_family == AF_INET) {
+    RETURN_SMI(
+        ntohs(reinterpret_cast<struct sockaddr_in*>(&address)->sin_port));
+  }
+  if (address.ss_family == AF_INET6) {
+    RETURN_SMI(
+        ntohs(reinterpret_cast<struct sockaddr_in6*>(&address)->sin6_port));
+  }
+  return kFailure;
+#endif
+}
+
+
+DEFINE_PRIMITIVE(Posix_errorString) {
+#if !defined(USING_POSIX_IO)
+  return kFailure;
+#else
+  ASSERT(num_args == 1);
+  SMI_ARGUMENT(error, 0);
+  char buffer[256];
+  const char* message = Utils::StrError(error, buffer, sizeof(buffer));
+  intptr_t length = strlen(message);
+  String* result = H->AllocateString(length);  // SAFEPOINT
+  memcpy(result->element_addr(0), message, length);
+  RETURN(result);
+#endif
+}
+
+
+// Read-only views of files mapped with Isolate::MapFile. The bytes live
+// outside the heap and never move, so reads go directly to the mapping.
+static bool MappedBytesArgument(Object* handle, const uint8_t** base,
+                                intptr_t* size) {
+  if (!handle->IsSmallInteger()) {
+    return false;
+  }
+  return Isolate::Current()->LookupMappedFile(
+      static_cast<SmallInteger*>(handle)->value(), base, size);
+}
+
+
+DEFINE_PRIMITIVE(MappedBytes_map) {
+  ASSERT(num_args == 1);
+  String* path = static_cast<String*>(I->Stack(0));
+  if (!path->IsString()) {
+    return kFailure;
+  }
+  char* raw_path = NewCString(path);
+  intptr_t handle = Isolate::Current()->MapFile(raw_path);
+  free(raw_path);
+  if (handle < 0) {
+    return kFailure;
+  }
+  RETURN_SMI(handle);
+}
+
+
+DEFINE_PRIMITIVE(MappedBytes_unmap) {
+  ASSERT(num_args == 1);
+  SMI_ARGUMENT(handle, 0);
+  if (!Isolate::Current()->UnmapFile(handle)) {
+    return kFailure;
+  }
+  RETURN_SELF();
+}
+
+
+DEFINE_PRIMITIVE(MappedBytes_size) {
+  ASSERT(num_args == 1);
+  const uint8_t* base;
+  intptr_t size;
+  if (!MappedBytesArgument(I->Stack(0), &base, &size)) {
+    return kFailure;
+  }
+  RETURN_MINT(size);
+}
+
+
+DEFINE_PRIMITIVE(MappedBytes_at) {
+  ASSERT(num_args == 2);
+  const uint8_t* base;
+  intptr_t size;
+  if (!MappedBytesArgument(I->Stack(1), &base, &size)) {
+    return kFailure;
+  }
+  SMI_ARGUMENT(index, 0);
+  index--;
+  if ((index < 0) || (index >= size)) {
+    return kFailure;
+  }
+  RETURN_SMI(static_cast<intptr_t>(base[index]));
+}
+
+
+DEFINE_PRIMITIVE(MappedBytes_copyFromTo) {
+  ASSERT(num_args == 3);
+  const uint8_t* base;
+  intptr_t size;
+  if (!MappedBytesArgument(I->Stack(2), &base, &size)) {
+    return kFailure;
+  }
+  SMI_ARGUMENT(start, 1);
+  SMI_ARGUMENT(stop, 0);
+  if ((start <= 0) || (stop > size)) {
+    return kFailure;
+  }
+  intptr_t subsize = stop - (start - 1);
+  if (subsize < 0) {
+    return kFailure;
+  }
+  // The mapping does not move, so base stays valid across the allocation.
+  ByteArray* result = H->AllocateByteArray(subsize);  // SAFEPOINT
+  memcpy(result->element_addr(0), base + start - 1, subsize);
+  RETURN(result);
+}
+
+
+DEFINE_PRIMITIVE(MappedBytes_indexOf) {
+  ASSERT(num_args == 3);
+  const uint8_t* base;
+  intptr_t size;
+  if (!MappedBytesArgument(I->Stack(2), &base, &size)) {
+    return kFailure;
+  }
+  Bytes* pattern = static_cast<Bytes*>(I->Stack(1));
+  if (!pattern->IsBytes()) {
+    return kFailure;
+  }
+  SMI_ARGUMENT(start, 0);
+  start--;
+  if ((start < 0) || (start > size)) {
+    return kFailure;
+  }
+  intptr_t index = IndexOfBytes(base, size, pattern->element_addr(0),
+                                pattern->Size(), start);
+  RETURN_MINT(index + 1);
+}
+
 #if defined(OS_EMSCRIPTEN)
 EM_JS(void, _JS_pushInteger, (int64_t value), {
   var aliens = Module.aliens;
@@ -3383,6 +4760,23 @@ DEFINE_PRIMITIVE(JS_performNew) {
 #endif
 }
 
+DEFINE_PRIMITIVE(executionCounters) {
+  ASSERT(num_args == 0);
+  if (!COUNT_EXECUTIONS) {
+    return kFailure;
+  }
+  intptr_t length = Interpreter::kNumExecutionCounters;
+  Array* result = H->AllocateArray(length);  // SAFEPOINT
+  for (intptr_t i = 0; i < length; i++) {
+    int64_t count = I->ExecutionCounterAt(i);
+    if (count > SmallInteger::kMaxValue) {
+      count = SmallInteger::kMaxValue;
+    }
+    result->set_element(i, SmallInteger::New(count), kNoBarrier);
+  }
+  RETURN(result);
+}
+
 DEFINE_PRIMITIVE(quickReturnSelf) {
   ASSERT(num_args == 0);
   return kSuccess;
@@ -3392,6 +4786,11 @@ DEFINE_PRIMITIVE(quickReturnSelf) {
 PrimitiveFunction** Primitives::primitive_table_ = NULL;
 
 
+void Primitives::CountInvocation(intptr_t prim, Interpreter* interpreter) {
+  interpreter->CountPrimitive(prim);
+}
+
+
 void Primitives::Startup() {
   primitive_table_ = new PrimitiveFunction*[kNumPrimitives];
   for (intptr_t i = 0; i < kNumPrimitives; i++) {
@@ -6,6 +6,7 @@
 #define VM_PRIMITIVES_H_
 
 #include "vm/assert.h"
+#include "vm/flags.h"
 #include "vm/globals.h"
 
 namespace psoup {
@@ -19,10 +20,13 @@ typedef bool (PrimitiveFunction)(intptr_t num_args,
 
 class Primitives {
  public:
+  static const intptr_t kNumPrimitives = 256;
+
   static void Startup();
   static void Shutdown();
 
   static bool IsUnwindProtect(intptr_t prim) { return prim == 113; }
+  static bool IsExceptionHandler(intptr_t prim) { return prim == 116; }
   static bool IsSimulationRoot(intptr_t prim) { return prim == 142; }
 
   static bool Invoke(intptr_t prim,
@@ -31,12 +35,15 @@ class Primitives {
                      Interpreter* interpreter) {
     ASSERT(prim > 0);
     ASSERT(prim < kNumPrimitives);
+    if (COUNT_EXECUTIONS) {
+      CountInvocation(prim, interpreter);
+    }
     PrimitiveFunction* func = primitive_table_[prim];
     return func(num_args, heap, interpreter);
   }
 
  private:
-  static const intptr_t kNumPrimitives = 256;
+  static void CountInvocation(intptr_t prim, Interpreter* interpreter);
 
   static PrimitiveFunction** primitive_table_;
 };
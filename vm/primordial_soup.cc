@@ -6,16 +6,21 @@
 
 #include "vm/flags.h"
 #include "vm/globals.h"
+#include "vm/heap.h"
+#include "vm/interpreter.h"
 #include "vm/isolate.h"
 #include "vm/message_loop.h"
 #include "vm/os.h"
+#include "vm/page_pool.h"
 #include "vm/port.h"
 #include "vm/primitives.h"
 #include "vm/snapshot.h"
 #include "vm/thread.h"
+#include "vm/virtual_memory.h"
 
 PSOUP_EXTERN_C void PrimordialSoup_Startup() {
   psoup::OS::Startup();
+  psoup::PagePool::Startup();
   psoup::Primitives::Startup();
   psoup::PortMap::Startup();
   psoup::Isolate::Startup();
@@ -26,16 +31,68 @@ PSOUP_EXTERN_C void PrimordialSoup_Shutdown() {
   psoup::Isolate::Shutdown();
   psoup::PortMap::Shutdown();
   psoup::Primitives::Shutdown();
+  psoup::PagePool::Shutdown();
   psoup::OS::Shutdown();
 }
 
 
+PSOUP_EXTERN_C void PrimordialSoup_SetStackSize(size_t size) {
+  psoup::Interpreter::SetStackSize(size);
+}
+
+
+PSOUP_EXTERN_C void PrimordialSoup_SetHeapLimits(size_t soft_limit,
+                                                 size_t hard_limit) {
+  psoup::Heap::SetLimits(soft_limit, hard_limit);
+}
+
+
+PSOUP_EXTERN_C void PrimordialSoup_SetScavengePolicy(int64_t pause_goal_micros,
+                                                     intptr_t max_tenure_age) {
+  psoup::Heap::SetScavengePolicy(
+      pause_goal_micros * kNanosecondsPerMicrosecond, max_tenure_age);
+}
+
+
+PSOUP_EXTERN_C void PrimordialSoup_SetHeapPlacement(bool huge_pages,
+                                                    bool numa_local) {
+  psoup::VirtualMemory::SetHugePages(huge_pages);
+  psoup::Isolate::SetNumaLocal(numa_local);
+  psoup::PagePool::SetNumaLocal(numa_local);
+}
+
+
+PSOUP_EXTERN_C void PrimordialSoup_SetPagePool(size_t capacity) {
+  psoup::PagePool::SetCapacity(capacity);
+}
+
+
+PSOUP_EXTERN_C void PrimordialSoup_SetIsolatePool(intptr_t idle_isolates,
+                                                  bool clone_template) {
+  psoup::Isolate::SetSpawnPolicy(idle_isolates, clone_template);
+}
+
+
+PSOUP_EXTERN_C void PrimordialSoup_GetIsolatePoolStatistics(intptr_t* hits,
+                                                            intptr_t* misses,
+                                                            intptr_t* idle,
+                                                            intptr_t* filling) {
+  psoup::Isolate::PoolStatistics(hits, misses, idle, filling);
+}
+
+
+PSOUP_EXTERN_C bool PrimordialSoup_SetMessageLoop(const char* name) {
+  return psoup::MessageLoop::SetImplementation(name);
+}
+
+
 PSOUP_EXTERN_C intptr_t PrimordialSoup_RunIsolate(void* snapshot,
                                                   size_t snapshot_length,
                                                   int argc,
                                                   const char** argv) {
   uint64_t seed = psoup::OS::CurrentMonotonicNanos();
   psoup::Isolate* isolate = new psoup::Isolate(snapshot, snapshot_length, seed);
+  psoup::Isolate::FillPool(snapshot, snapshot_length);
   isolate->loop()->PostMessage(new psoup::IsolateMessage(ILLEGAL_PORT,
                                                          argc, argv));
   intptr_t exit_code = isolate->loop()->Run();
@@ -7,6 +7,7 @@
 #ifndef VM_PRIMORDIAL_SOUP_H_
 #define VM_PRIMORDIAL_SOUP_H_
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -18,6 +19,21 @@
 
 PSOUP_EXTERN_C void PrimordialSoup_Startup();
 PSOUP_EXTERN_C void PrimordialSoup_Shutdown();
+PSOUP_EXTERN_C void PrimordialSoup_SetStackSize(size_t size);
+PSOUP_EXTERN_C void PrimordialSoup_SetHeapLimits(size_t soft_limit,
+                                                 size_t hard_limit);
+PSOUP_EXTERN_C void PrimordialSoup_SetScavengePolicy(int64_t pause_goal_micros,
+                                                     intptr_t max_tenure_age);
+PSOUP_EXTERN_C void PrimordialSoup_SetHeapPlacement(bool huge_pages,
+                                                    bool numa_local);
+PSOUP_EXTERN_C void PrimordialSoup_SetPagePool(size_t capacity);
+PSOUP_EXTERN_C void PrimordialSoup_SetIsolatePool(intptr_t idle_isolates,
+                                                  bool clone_template);
+PSOUP_EXTERN_C void PrimordialSoup_GetIsolatePoolStatistics(intptr_t* hits,
+                                                            intptr_t* misses,
+                                                            intptr_t* idle,
+                                                            intptr_t* filling);
+PSOUP_EXTERN_C bool PrimordialSoup_SetMessageLoop(const char* name);
 PSOUP_EXTERN_C intptr_t PrimordialSoup_RunIsolate(void* snapshot,
                                                   size_t snapshot_length,
                                                   int argc, const char** argv);
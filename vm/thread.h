@@ -44,6 +44,13 @@ class Thread : public AllStatic {
   static ThreadId ThreadIdFromIntPtr(intptr_t id);
   static bool Compare(ThreadId a, ThreadId b);
 
+  // Restricts the current thread to the CPUs of the NUMA node it is running
+  // on, so the memory it touches first is allocated on that node and stays
+  // local to it. Answers false if unsupported.
+  static bool BindToCurrentNumaNode();
+  // Restores the CPUs the current thread could run on before binding.
+  static void UnbindFromNumaNode();
+
   // This function can be called only once per Thread, and should only be
   // called when the returned id will eventually be passed to Thread::Join().
   static ThreadJoinId GetCurrentThreadJoinId();
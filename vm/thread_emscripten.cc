@@ -60,6 +60,15 @@ bool Thread::Compare(ThreadId a, ThreadId b) {
 }
 
 
+bool Thread::BindToCurrentNumaNode() {
+  return false;
+}
+
+
+void Thread::UnbindFromNumaNode() {
+}
+
+
 Mutex::Mutex() {}
 
 
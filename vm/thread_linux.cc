@@ -8,6 +8,10 @@
 #include "vm/thread.h"
 
 #include <errno.h>         // NOLINT
+#include <fcntl.h>         // NOLINT
+#include <sched.h>         // NOLINT
+#include <stdio.h>         // NOLINT
+#include <stdlib.h>        // NOLINT
 #include <sys/resource.h>  // NOLINT
 #include <sys/syscall.h>   // NOLINT
 #include <sys/time.h>      // NOLINT
@@ -153,6 +157,83 @@ bool Thread::Compare(ThreadId a, ThreadId b) {
 }
 
 
+// The CPUs the thread could run on before BindToCurrentNumaNode.
+static thread_local cpu_set_t unbound_cpus;
+static thread_local bool is_bound = false;
+
+
+// Parses a cpulist such as "0-7,16-23" from sysfs.
+static bool ReadNodeCpus(unsigned node, cpu_set_t* cpus) {
+  char path[64];
+  snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist",
+           node);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  char buffer[4096];
+  ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+  close(fd);
+  if (length <= 0) {
+    return false;
+  }
+  buffer[length] = 0;
+
+  CPU_ZERO(cpus);
+  char* cursor = buffer;
+  while ((*cursor >= '0') && (*cursor <= '9')) {
+    intptr_t first = strtol(cursor, &cursor, 10);
+    intptr_t last = first;
+    if (*cursor == '-') {
+      last = strtol(cursor + 1, &cursor, 10);
+    }
+    for (intptr_t cpu = first; (cpu <= last) && (cpu < CPU_SETSIZE); cpu++) {
+      CPU_SET(cpu, cpus);
+    }
+    if (*cursor == ',') {
+      cursor++;
+    }
+  }
+  return CPU_COUNT(cpus) != 0;
+}
+
+
+bool Thread::BindToCurrentNumaNode() {
+  unsigned cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) {
+    return false;
+  }
+  cpu_set_t node_cpus;
+  if (!ReadNodeCpus(node, &node_cpus)) {
+    return false;
+  }
+  cpu_set_t allowed;
+  if (pthread_getaffinity_np(pthread_self(), sizeof(allowed), &allowed) != 0) {
+    return false;
+  }
+  CPU_AND(&node_cpus, &node_cpus, &allowed);
+  if (CPU_COUNT(&node_cpus) == 0) {
+    return false;
+  }
+  if (pthread_setaffinity_np(pthread_self(), sizeof(node_cpus),
+                             &node_cpus) != 0) {
+    return false;
+  }
+  unbound_cpus = allowed;
+  is_bound = true;
+  return true;
+}
+
+
+void Thread::UnbindFromNumaNode() {
+  if (!is_bound) {
+    return;
+  }
+  pthread_setaffinity_np(pthread_self(), sizeof(unbound_cpus), &unbound_cpus);
+  is_bound = false;
+}
+
+
 Mutex::Mutex() {
   pthread_mutexattr_t attr;
   int result = pthread_mutexattr_init(&attr);
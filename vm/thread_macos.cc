@@ -160,6 +160,15 @@ bool Thread::Compare(ThreadId a, ThreadId b) {
 }
 
 
+bool Thread::BindToCurrentNumaNode() {
+  return false;
+}
+
+
+void Thread::UnbindFromNumaNode() {
+}
+
+
 Mutex::Mutex() {
   pthread_mutexattr_t attr;
   int result = pthread_mutexattr_init(&attr);
@@ -120,6 +120,15 @@ bool Thread::Compare(ThreadId a, ThreadId b) {
 }
 
 
+bool Thread::BindToCurrentNumaNode() {
+  return false;
+}
+
+
+void Thread::UnbindFromNumaNode() {
+}
+
+
 Mutex::Mutex() {
   InitializeSRWLock(&data_.lock_);
 #if defined(DEBUG)
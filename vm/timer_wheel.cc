@@ -0,0 +1,225 @@
+// Copyright (c) 2018, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#include "vm/timer_wheel.h"
+
+#include "vm/assert.h"
+#include "vm/os.h"
+#include "vm/utils.h"
+
+namespace psoup {
+
+TimerWheel::TimerWheel()
+    : timers_(NULL),
+      capacity_(0),
+      free_(-1),
+      current_(OS::CurrentMonotonicNanos() / kNanosecondsPerMillisecond),
+      expired_count_(0) {
+  for (intptr_t i = 0; i < kLevels * kSlots; i++) {
+    slots_[i].head = slots_[i].tail = -1;
+  }
+  for (intptr_t i = 0; i < kLevels; i++) {
+    occupied_[i] = 0;
+  }
+  overflow_.head = overflow_.tail = -1;
+  expired_.head = expired_.tail = -1;
+}
+
+TimerWheel::~TimerWheel() {
+  free(timers_);
+}
+
+intptr_t TimerWheel::Schedule(int64_t deadline) {
+  if (free_ == -1) {
+    intptr_t new_capacity = capacity_ == 0 ? 64 : capacity_ * 2;
+    if (new_capacity > (static_cast<intptr_t>(1) << kIndexBits)) {
+      return -1;
+    }
+    timers_ = reinterpret_cast<Timer*>(
+        realloc(timers_, new_capacity * sizeof(Timer)));
+    if (timers_ == NULL) {
+      FATAL("Out of memory");
+    }
+    for (intptr_t i = new_capacity - 1; i >= capacity_; i--) {
+      timers_[i].in_use = false;
+      timers_[i].generation = 0;
+      timers_[i].next = free_;
+      free_ = i;
+    }
+    capacity_ = new_capacity;
+  }
+
+  intptr_t index = free_;
+  Timer* timer = &timers_[index];
+  free_ = timer->next;
+  timer->in_use = true;
+  // Round up so that a timer never fires before its deadline.
+  timer->deadline = (deadline + kNanosecondsPerMillisecond - 1) /
+      kNanosecondsPerMillisecond;
+  Insert(index);
+  return (timer->generation << kIndexBits) | index;
+}
+
+bool TimerWheel::Cancel(intptr_t id) {
+  intptr_t index = id & ((static_cast<intptr_t>(1) << kIndexBits) - 1);
+  intptr_t generation = id >> kIndexBits;
+  if ((id < 0) || (index >= capacity_)) {
+    return false;
+  }
+  Timer* timer = &timers_[index];
+  if (!timer->in_use || (timer->generation != generation)) {
+    return false;
+  }
+  Remove(index);
+  if (timer->list == kExpired) {
+    expired_count_--;
+  }
+  Free(index);
+  return true;
+}
+
+void TimerWheel::Free(intptr_t index) {
+  Timer* timer = &timers_[index];
+  timer->in_use = false;
+  timer->generation = (timer->generation + 1) & ((1 << kGenerationBits) - 1);
+  timer->next = free_;
+  free_ = index;
+}
+
+TimerWheel::List* TimerWheel::ListAt(intptr_t list) {
+  if (list == kExpired) {
+    return &expired_;
+  }
+  if (list == kOverflow) {
+    return &overflow_;
+  }
+  return &slots_[list];
+}
+
+void TimerWheel::Append(intptr_t list, intptr_t index) {
+  Timer* timer = &timers_[index];
+  List* l = ListAt(list);
+  timer->list = list;
+  timer->next = -1;
+  timer->prev = l->tail;
+  if (l->tail == -1) {
+    l->head = index;
+  } else {
+    timers_[l->tail].next = index;
+  }
+  l->tail = index;
+  if (list >= 0) {
+    occupied_[list / kSlots] |= static_cast<uint64_t>(1) << (list % kSlots);
+  }
+}
+
+void TimerWheel::Remove(intptr_t index) {
+  Timer* timer = &timers_[index];
+  List* l = ListAt(timer->list);
+  if (timer->prev == -1) {
+    l->head = timer->next;
+  } else {
+    timers_[timer->prev].next = timer->next;
+  }
+  if (timer->next == -1) {
+    l->tail = timer->prev;
+  } else {
+    timers_[timer->next].prev = timer->prev;
+  }
+  if ((timer->list >= 0) && (l->head == -1)) {
+    occupied_[timer->list / kSlots] &=
+        ~(static_cast<uint64_t>(1) << (timer->list % kSlots));
+  }
+}
+
+void TimerWheel::Insert(intptr_t index) {
+  int64_t deadline = timers_[index].deadline;
+  if (deadline <= current_) {
+    Append(kExpired, index);
+    expired_count_++;
+    return;
+  }
+  intptr_t level = Utils::HighestBit(deadline ^ current_) / kSlotBits;
+  if (level >= kLevels) {
+    Append(kOverflow, index);
+    return;
+  }
+  intptr_t slot = (deadline >> (level * kSlotBits)) & (kSlots - 1);
+  Append(level * kSlots + slot, index);
+}
+
+// Every occupied slot starts after current_, and slots at lower levels start
+// before slots at higher levels, so the earliest slot is the lowest occupied
+// one at the lowest occupied level.
+bool TimerWheel::NextExpiration(intptr_t* list, int64_t* tick) const {
+  for (intptr_t level = 0; level < kLevels; level++) {
+    if (occupied_[level] != 0) {
+      intptr_t slot = Utils::LowestBit(occupied_[level]);
+      intptr_t shift = level * kSlotBits;
+      int64_t window = static_cast<int64_t>(1) << (shift + kSlotBits);
+      *list = level * kSlots + slot;
+      *tick = (current_ & ~(window - 1)) |
+          (static_cast<int64_t>(slot) << shift);
+      return true;
+    }
+  }
+  if (overflow_.head != -1) {
+    int64_t window = static_cast<int64_t>(1) << (kLevels * kSlotBits);
+    *list = kOverflow;
+    *tick = (current_ & ~(window - 1)) + window;
+    return true;
+  }
+  return false;
+}
+
+void TimerWheel::Advance(int64_t now) {
+  int64_t now_tick = now / kNanosecondsPerMillisecond;
+  intptr_t list;
+  int64_t tick;
+  while (NextExpiration(&list, &tick) && (tick <= now_tick)) {
+    current_ = tick;
+    List* l = ListAt(list);
+    intptr_t index = l->head;
+    l->head = l->tail = -1;
+    if (list >= 0) {
+      occupied_[list / kSlots] &=
+          ~(static_cast<uint64_t>(1) << (list % kSlots));
+    }
+    while (index != -1) {
+      intptr_t next = timers_[index].next;
+      Insert(index);
+      index = next;
+    }
+  }
+  if (now_tick > current_) {
+    current_ = now_tick;
+  }
+}
+
+intptr_t TimerWheel::TakeExpired() {
+  intptr_t index = expired_.head;
+  if (index == -1) {
+    return -1;
+  }
+  Timer* timer = &timers_[index];
+  intptr_t id = (timer->generation << kIndexBits) | index;
+  Remove(index);
+  expired_count_--;
+  Free(index);
+  return id;
+}
+
+int64_t TimerWheel::NextWakeup() const {
+  if (expired_count_ != 0) {
+    return current_ * kNanosecondsPerMillisecond;
+  }
+  intptr_t list;
+  int64_t tick;
+  if (NextExpiration(&list, &tick)) {
+    return tick * kNanosecondsPerMillisecond;
+  }
+  return 0;
+}
+
+}  // namespace psoup
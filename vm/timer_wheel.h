@@ -0,0 +1,92 @@
+// Copyright (c) 2018, the Dart project authors.  Please see the AUTHORS file
+// for details. All rights reserved. Use of this source code is governed by a
+// BSD-style license that can be found in the LICENSE file.
+
+#ifndef VM_TIMER_WHEEL_H_
+#define VM_TIMER_WHEEL_H_
+
+#include "vm/globals.h"
+
+namespace psoup {
+
+// A hierarchical timer wheel with millisecond ticks. Scheduling and
+// cancelling are constant time, and advancing skips over empty slots, so the
+// cost does not grow with the number of pending timers or with how long the
+// loop slept.
+//
+// Level L has 64 slots of 64^L ticks each. A timer is kept at the level of
+// the highest 6-bit group in which its deadline differs from the current
+// tick, so every timer at a lower level is due before any timer at a higher
+// level. When the current tick reaches a slot, its timers are either expired
+// or moved to a lower level.
+class TimerWheel {
+ public:
+  TimerWheel();
+  ~TimerWheel();
+
+  // Answers an id for a timer due at deadline, in monotonic nanoseconds.
+  intptr_t Schedule(int64_t deadline);
+  // Answers false if the timer has already expired or been cancelled.
+  bool Cancel(intptr_t id);
+
+  // Moves timers due at or before now to the expired list.
+  void Advance(int64_t now);
+  intptr_t expired_count() const { return expired_count_; }
+  // Answers the id of the earliest expired timer and forgets it.
+  intptr_t TakeExpired();
+
+  // Answers when the loop should next call Advance, in monotonic
+  // nanoseconds, or 0 if there are no timers. May be earlier than any
+  // deadline when timers must move down a level.
+  int64_t NextWakeup() const;
+
+ private:
+  static const intptr_t kLevels = 6;
+  static const intptr_t kSlotBits = 6;
+  static const intptr_t kSlots = 1 << kSlotBits;
+  static const intptr_t kOverflow = -2;
+  static const intptr_t kExpired = -1;
+  // Ids combine an index into timers_ with a generation, so that the id of a
+  // timer that has expired or been cancelled is not mistaken for a later
+  // timer reusing the index. Ids stay within the SmallInteger range.
+  static const intptr_t kIndexBits = 20;
+  static const intptr_t kGenerationBits = 10;
+
+  struct Timer {
+    int64_t deadline;  // In ticks.
+    intptr_t next;
+    intptr_t prev;
+    intptr_t list;  // Level * kSlots + slot, kOverflow or kExpired.
+    intptr_t generation;
+    bool in_use;
+  };
+
+  struct List {
+    intptr_t head;
+    intptr_t tail;
+  };
+
+  void Free(intptr_t index);
+  List* ListAt(intptr_t list);
+  void Insert(intptr_t index);
+  void Append(intptr_t list, intptr_t index);
+  void Remove(intptr_t index);
+  bool NextExpiration(intptr_t* list, int64_t* tick) const;
+
+  Timer* timers_;
+  intptr_t capacity_;
+  intptr_t free_;
+
+  int64_t current_;  // Tick up to which timers have been expired.
+  List slots_[kLevels * kSlots];
+  uint64_t occupied_[kLevels];
+  List overflow_;
+  List expired_;
+  intptr_t expired_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+}  // namespace psoup
+
+#endif  // VM_TIMER_WHEEL_H_
@@ -42,6 +42,22 @@ class Utils {
 #endif
   }
 
+  static inline int LowestBit(uint64_t x) {
+    ASSERT(x != 0);
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    int r = 0;
+    if ((x & 0xFFFFFFFF) == 0) { x >>= 32; r += 32; }
+    if ((x & 0xFFFF) == 0) { x >>= 16; r += 16; }
+    if ((x & 0xFF) == 0) { x >>= 8; r += 8; }
+    if ((x & 0xF) == 0) { x >>= 4; r += 4; }
+    if ((x & 0x3) == 0) { x >>= 2; r += 2; }
+    if ((x & 0x1) == 0) r += 1;
+    return r;
+#endif
+  }
+
   static int BitLength(int64_t value) {
     // Flip bits if negative (-1 becomes 0).
     value ^= value >> (8 * sizeof(value) - 1);
@@ -59,6 +75,28 @@ class Utils {
     return (x & (n - 1)) == 0;
   }
 
+  static inline uint16_t ByteSwap16(uint16_t x) {
+    return static_cast<uint16_t>((x >> 8) | (x << 8));
+  }
+
+  static inline uint32_t ByteSwap32(uint32_t x) {
+#if defined(__GNUC__)
+    return __builtin_bswap32(x);
+#else
+    return ((x >> 24) & 0xFF) | ((x >> 8) & 0xFF00) |
+        ((x & 0xFF00) << 8) | ((x & 0xFF) << 24);
+#endif
+  }
+
+  static inline uint64_t ByteSwap64(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_bswap64(x);
+#else
+    return (static_cast<uint64_t>(ByteSwap32(static_cast<uint32_t>(x))) << 32) |
+        ByteSwap32(static_cast<uint32_t>(x >> 32));
+#endif
+  }
+
   static char* StrError(int err, char* buffer, size_t bufsize);
 };
 
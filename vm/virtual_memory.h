@@ -17,13 +17,29 @@ class VirtualMemory {
     kReadWrite,
   };
 
+  static const size_t kHugePageSize = 2 * MB;
+
+  // Process-wide; set before any isolate starts. When enabled, read-write
+  // allocations of at least kHugePageSize are aligned to it and marked for
+  // transparent huge pages, where the OS supports them.
+  static void SetHugePages(bool enabled);
+
+  // Answers false if the file cannot be opened or mapped.
+  static bool TryMapReadOnly(const char* filename, VirtualMemory* result);
   static VirtualMemory MapReadOnly(const char* filename);
   static VirtualMemory Allocate(size_t size,
                                 Protection protection,
                                 const char* name);
   void Free();
+  // Releases memory from MapReadOnly.
+  void Unmap();
   bool Protect(Protection protection);
 
+  // Returns the physical pages backing [address, address + size) to the OS
+  // while keeping the range mapped. The contents become undefined. Partial
+  // pages at either end are left alone.
+  void DontNeed(uword address, size_t size);
+
   uword base() const { return reinterpret_cast<uword>(address_); }
   uword limit() const { return base() + size(); }
   size_t size() const { return size_; }
@@ -12,12 +12,23 @@
 
 namespace psoup {
 
+bool VirtualMemory::TryMapReadOnly(const char* filename,
+                                   VirtualMemory* result) {
+  return false;
+}
+
+
 VirtualMemory VirtualMemory::MapReadOnly(const char* filename) {
   UNREACHABLE();
   return VirtualMemory(NULL, 0);
 }
 
 
+void VirtualMemory::SetHugePages(bool enabled) {
+  // Not supported.
+}
+
+
 VirtualMemory VirtualMemory::Allocate(size_t size,
                                       Protection protection,
                                       const char* name) {
@@ -34,6 +45,16 @@ void VirtualMemory::Free() {
 }
 
 
+void VirtualMemory::Unmap() {
+  UNREACHABLE();
+}
+
+
+void VirtualMemory::DontNeed(uword address, size_t size) {
+  // Memory from malloc cannot be returned piecemeal.
+}
+
+
 bool VirtualMemory::Protect(Protection protection) {
   return true;
 }
@@ -14,34 +14,53 @@
 #include <zircon/syscalls.h>
 
 #include "vm/assert.h"
+#include "vm/utils.h"
 
 namespace psoup {
 
-VirtualMemory VirtualMemory::MapReadOnly(const char* filename) {
+bool VirtualMemory::TryMapReadOnly(const char* filename,
+                                   VirtualMemory* result) {
   int fd = open(filename, O_RDONLY);
   if (fd < 0) {
-    FATAL1("Failed to open '%s'\n", filename);
+    return false;
   }
   zx_handle_t vmo = ZX_HANDLE_INVALID;
   zx_status_t status = fdio_get_vmo_clone(fd, &vmo);
   close(fd);
   if (status != ZX_OK) {
-    FATAL1("fdio_get_vmo() failed: %s\n", zx_status_get_string(status));
+    return false;
   }
   size_t size;
   status = zx_vmo_get_size(vmo, &size);
   if (status != ZX_OK) {
-    FATAL1("zx_vmo_get_size() failed: %s\n", zx_status_get_string(status));
+    zx_handle_close(vmo);
+    return false;
+  }
+  uintptr_t addr = 0;
+  if (size != 0) {
+    zx_handle_t vmar = zx_vmar_root_self();
+    status = zx_vmar_map(vmar, ZX_VM_FLAG_PERM_READ, 0, vmo, 0, size, &addr);
   }
-  zx_handle_t vmar = zx_vmar_root_self();
-  uintptr_t addr;
-  status = zx_vmar_map(vmar, ZX_VM_FLAG_PERM_READ, 0, vmo, 0, size, &addr);
   zx_handle_close(vmo);
   if (status != ZX_OK) {
-    FATAL2("zx_vmar_map(%" Pd ") failed: %s\n", size,
-           zx_status_get_string(status));
+    return false;
   }
-  return VirtualMemory(reinterpret_cast<void*>(addr), size);
+  *result = VirtualMemory(reinterpret_cast<void*>(addr), size);
+  return true;
+}
+
+
+VirtualMemory VirtualMemory::MapReadOnly(const char* filename) {
+  VirtualMemory result;
+  if (!TryMapReadOnly(filename, &result)) {
+    FATAL1("Failed to map '%s'\n", filename);
+  }
+  return result;
+}
+
+
+void VirtualMemory::SetHugePages(bool enabled) {
+  // Not supported.
 }
 
 
@@ -98,6 +117,30 @@ void VirtualMemory::Free() {
 }
 
 
+void VirtualMemory::Unmap() {
+  if (size_ != 0) {
+    Free();
+  }
+}
+
+
+void VirtualMemory::DontNeed(uword address, size_t size) {
+  ASSERT((address >= base()) && (address + size <= limit()));
+  intptr_t page_size = zx_system_get_page_size();
+  uword start = Utils::RoundUp(address, page_size);
+  uword end = Utils::RoundDown(address + size, page_size);
+  if (start >= end) {
+    return;
+  }
+  zx_handle_t vmar = zx_vmar_root_self();
+  zx_status_t status = zx_vmar_op_range(vmar, ZX_VMAR_OP_DECOMMIT, start,
+                                        end - start, NULL, 0);
+  if (status != ZX_OK) {
+    FATAL1("zx_vmar_op_range failed: %s\n", zx_status_get_string(status));
+  }
+}
+
+
 bool VirtualMemory::Protect(Protection protection) {
   uint32_t prot;
   switch (protection) {
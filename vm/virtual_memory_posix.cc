@@ -7,40 +7,103 @@
 
 #include "vm/virtual_memory.h"
 
+#include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include "vm/assert.h"
 #include "vm/os.h"
+#include "vm/utils.h"
 
 namespace psoup {
 
-VirtualMemory VirtualMemory::MapReadOnly(const char* filename) {
-  FILE* file = fopen(filename, "r");
-  if (file == NULL) {
-    FATAL1("Failed to open '%s'\n", filename);
+bool VirtualMemory::TryMapReadOnly(const char* filename,
+                                   VirtualMemory* result) {
+  int fd = open(filename, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
   }
   struct stat st;
-  if (fstat(fileno(file), &st) != 0) {
-    FATAL1("Failed to stat '%s'\n", filename);
+  if ((fstat(fd, &st) != 0) || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return false;
   }
   intptr_t size = st.st_size;
-  void* address = mmap(0, size, PROT_READ,
-                       MAP_FILE | MAP_PRIVATE,
-                       fileno(file), 0);
+  void* address = NULL;
+  if (size != 0) {  // mmap rejects empty mappings.
+    address = mmap(0, size, PROT_READ, MAP_FILE | MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED) {
+      close(fd);
+      return false;
+    }
+  }
+  close(fd);
+  *result = VirtualMemory(address, size);
+  return true;
+}
+
+
+VirtualMemory VirtualMemory::MapReadOnly(const char* filename) {
+  VirtualMemory result;
+  if (!TryMapReadOnly(filename, &result)) {
+    FATAL1("Failed to map '%s'\n", filename);
+  }
+  return result;
+}
+
+
+#if defined(MADV_HUGEPAGE)
+static bool huge_pages = false;
+
+
+// Transparent huge pages only back whole aligned huge pages, so map enough to
+// align the region and trim the ends.
+static void* AllocateHuge(size_t size) {
+  size_t mapped_size = size + VirtualMemory::kHugePageSize;
+  void* address = mmap(0, mapped_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANON,
+                       0, 0);
   if (address == MAP_FAILED) {
-    FATAL1("Failed to mmap '%s'\n", filename);
+    return address;
+  }
+  uword start = reinterpret_cast<uword>(address);
+  uword aligned = Utils::RoundUp(start, VirtualMemory::kHugePageSize);
+  uword end = start + mapped_size;
+  if (aligned > start) {
+    munmap(address, aligned - start);
   }
-  int result = fclose(file);
-  ASSERT(result == 0);
+  if (end > aligned + size) {
+    munmap(reinterpret_cast<void*>(aligned + size), end - (aligned + size));
+  }
+  // Fails if the kernel was built without transparent huge pages, which only
+  // costs the alignment.
+  madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+  return reinterpret_cast<void*>(aligned);
+}
+#endif
 
-  return VirtualMemory(address, size);
+
+void VirtualMemory::SetHugePages(bool enabled) {
+#if defined(MADV_HUGEPAGE)
+  huge_pages = enabled;
+#endif
 }
 
 
 VirtualMemory VirtualMemory::Allocate(size_t size,
                                       Protection protection,
                                       const char* name) {
+#if defined(MADV_HUGEPAGE)
+  if (huge_pages && (protection == kReadWrite) && (size >= kHugePageSize)) {
+    void* address = AllocateHuge(size);
+    if (address == MAP_FAILED) {
+      FATAL1("Failed to mmap %" Pd " bytes\n", size);
+    }
+    return VirtualMemory(address, size);
+  }
+#endif
+
   int prot;
   switch (protection) {
     case kNoAccess: prot = PROT_NONE; break;
@@ -70,6 +133,29 @@ void VirtualMemory::Free() {
 }
 
 
+void VirtualMemory::Unmap() {
+  if (size_ != 0) {
+    Free();
+  }
+}
+
+
+void VirtualMemory::DontNeed(uword address, size_t size) {
+  ASSERT((address >= base()) && (address + size <= limit()));
+  intptr_t page_size = getpagesize();
+  uword start = Utils::RoundUp(address, page_size);
+  uword end = Utils::RoundDown(address + size, page_size);
+  if (start >= end) {
+    return;
+  }
+  int result = madvise(reinterpret_cast<void*>(start), end - start,
+                       MADV_DONTNEED);
+  if (result != 0) {
+    FATAL1("Failed to madvise %" Pd " bytes\n", end - start);
+  }
+}
+
+
 bool VirtualMemory::Protect(Protection protection) {
 #if defined(__aarch64__)
   // mprotect crashes my DragonBoard, so skip on ARM64.
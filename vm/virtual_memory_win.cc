@@ -9,10 +9,12 @@
 
 #include "vm/assert.h"
 #include "vm/os.h"
+#include "vm/utils.h"
 
 namespace psoup {
 
-VirtualMemory VirtualMemory::MapReadOnly(const char* filename) {
+bool VirtualMemory::TryMapReadOnly(const char* filename,
+                                   VirtualMemory* result) {
   HANDLE file = CreateFile(filename,
                            GENERIC_READ,
                            FILE_SHARE_READ,
@@ -20,26 +22,44 @@ VirtualMemory VirtualMemory::MapReadOnly(const char* filename) {
                            OPEN_EXISTING,
                            0,
                            NULL);
-  if (file == NULL) {
-    FATAL1("Failed to open '%s'\n", filename);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
   }
   BY_HANDLE_FILE_INFORMATION stat;
-  bool r = GetFileInformationByHandle(file, &stat);
-  ASSERT(r);
+  if (!GetFileInformationByHandle(file, &stat)) {
+    CloseHandle(file);
+    return false;
+  }
   int64_t size = (static_cast<int64_t>(stat.nFileSizeHigh) << 32) |
       stat.nFileSizeLow;
-  HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
-  if (mapping == NULL) {
-    FATAL("Failed CreateFileMapping\n");
+  void* address = NULL;
+  if (size != 0) {  // Empty files cannot be mapped.
+    HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping != NULL) {
+      address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+      CloseHandle(mapping);  // The view keeps the mapping alive.
+    }
   }
-  void* address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
-  if (address == 0) {
-    FATAL("Failed MapViewOfFile\n");
+  CloseHandle(file);
+  if ((size != 0) && (address == NULL)) {
+    return false;
   }
-  r = CloseHandle(file);
-  ASSERT(r);
+  *result = VirtualMemory(address, size);
+  return true;
+}
 
-  return VirtualMemory(address, size);
+
+VirtualMemory VirtualMemory::MapReadOnly(const char* filename) {
+  VirtualMemory result;
+  if (!TryMapReadOnly(filename, &result)) {
+    FATAL1("Failed to map '%s'\n", filename);
+  }
+  return result;
+}
+
+
+void VirtualMemory::SetHugePages(bool enabled) {
+  // Not supported.
 }
 
 
@@ -72,6 +92,31 @@ void VirtualMemory::Free() {
 }
 
 
+void VirtualMemory::Unmap() {
+  if ((size_ != 0) && (UnmapViewOfFile(address_) == 0)) {
+    FATAL1("UnmapViewOfFile failed %d", GetLastError());
+  }
+}
+
+
+void VirtualMemory::DontNeed(uword address, size_t size) {
+  ASSERT((address >= base()) && (address + size <= limit()));
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  intptr_t page_size = info.dwPageSize;
+  uword start = Utils::RoundUp(address, page_size);
+  uword end = Utils::RoundDown(address + size, page_size);
+  if (start >= end) {
+    return;
+  }
+  void* result = VirtualAlloc(reinterpret_cast<void*>(start), end - start,
+                              MEM_RESET, PAGE_READWRITE);
+  if (result == NULL) {
+    FATAL1("VirtualAlloc(MEM_RESET) failed %d", GetLastError());
+  }
+}
+
+
 bool VirtualMemory::Protect(Protection protection) {
   DWORD prot;
   switch (protection) {